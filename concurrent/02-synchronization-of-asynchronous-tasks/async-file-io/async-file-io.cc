@@ -0,0 +1,325 @@
+#include "async-file-io.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
+
+// completion callbacks may queue more requests, but must not wait for
+// capacity that only the completion path itself can free; theirs is deferred
+static thread_local bool in_completion = false;
+// the kernel caps a single read or write at this many bytes anyway
+static constexpr std::size_t max_rw = 0x7ffff000;
+
+#ifdef HAVE_IO_URING
+// The three shared mappings of an io_uring instance. Only the submitting
+// side (under m_) writes the SQ tail and only the reaper writes the CQ
+// head; the kernel owns the other two indices.
+struct AsyncFileIO::Ring {
+    int fd = -1;
+    void *sq_map = MAP_FAILED;
+    std::size_t sq_map_size = 0;
+    void *cq_map = MAP_FAILED;
+    std::size_t cq_map_size = 0;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    std::size_t sqes_size = 0;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned sq_entries;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe *cqes;
+    unsigned cq_entries;
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqes_size);
+        }
+        if (cq_map != MAP_FAILED && cq_map != sq_map) {
+            munmap(cq_map, cq_map_size);
+        }
+        if (sq_map != MAP_FAILED) {
+            munmap(sq_map, sq_map_size);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    };
+
+    static std::unique_ptr<Ring> open(unsigned depth) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        auto r = std::make_unique<Ring>();
+        r->fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &p));
+        // IORING_OP_READ and IORING_OP_WRITE arrived in 5.6 with this flag
+        if (r->fd < 0 || !(p.features & IORING_FEAT_RW_CUR_POS)) {
+            return nullptr;
+        }
+        r->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        r->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            r->sq_map_size = r->cq_map_size = std::max(r->sq_map_size, r->cq_map_size);
+        }
+        r->sq_map = mmap(nullptr, r->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         r->fd, IORING_OFF_SQ_RING);
+        if (r->sq_map == MAP_FAILED) {
+            return nullptr;
+        }
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            r->cq_map = r->sq_map;
+        } else {
+            r->cq_map = mmap(nullptr, r->cq_map_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+            if (r->cq_map == MAP_FAILED) {
+                return nullptr;
+            }
+        }
+        r->sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        r->sqes = static_cast<io_uring_sqe *>(mmap(nullptr, r->sqes_size, PROT_READ | PROT_WRITE,
+                                                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES));
+        if (r->sqes == MAP_FAILED) {
+            return nullptr;
+        }
+        auto *sq = static_cast<char *>(r->sq_map);
+        auto *cq = static_cast<char *>(r->cq_map);
+        r->sq_head = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+        r->sq_tail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+        r->sq_mask = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+        r->sq_array = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+        r->sq_entries = p.sq_entries;
+        r->cq_head = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+        r->cq_tail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+        r->cq_mask = reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+        r->cqes = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+        r->cq_entries = p.cq_entries;
+        return r;
+    };
+
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return static_cast<int>(
+            syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    };
+
+    // room left in the SQ, as seen from the submitting side
+    unsigned sq_space() {
+        const unsigned head = std::atomic_ref<unsigned>(*sq_head).load(std::memory_order_acquire);
+        return sq_entries - (*sq_tail - head);
+    };
+
+    // fills the next SQE; user_data 0 is the reaper's stop request
+    void prepare(const Op *op) {
+        const unsigned tail = *sq_tail;
+        const unsigned idx = tail & *sq_mask;
+        io_uring_sqe &sqe = sqes[idx];
+        std::memset(&sqe, 0, sizeof(sqe));
+        if (!op) {
+            sqe.opcode = IORING_OP_NOP;
+        } else {
+            switch (op->opcode) {
+            case op_read: sqe.opcode = IORING_OP_READ; break;
+            case op_write: sqe.opcode = IORING_OP_WRITE; break;
+            case op_read_fixed: sqe.opcode = IORING_OP_READ_FIXED; break;
+            case op_write_fixed: sqe.opcode = IORING_OP_WRITE_FIXED; break;
+            }
+            sqe.fd = op->fd;
+            sqe.addr = reinterpret_cast<std::uint64_t>(op->buf);
+            sqe.len = static_cast<std::uint32_t>(std::min(op->len, max_rw));
+            sqe.off = static_cast<std::uint64_t>(op->offset);
+            if (op->buf_index >= 0) {
+                sqe.buf_index = static_cast<std::uint16_t>(op->buf_index);
+            }
+        }
+        sqe.user_data = reinterpret_cast<std::uint64_t>(op);
+        sq_array[idx] = idx;
+        std::atomic_ref<unsigned>(*sq_tail).store(tail + 1, std::memory_order_release);
+    };
+
+    // hands n prepared SQEs to the kernel
+    void flush(unsigned n) {
+        while (n != 0) {
+            const int r = enter(n, 0, 0);
+            if (r < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                throw std::system_error(errno, std::system_category(), "io_uring_enter");
+            }
+            n -= static_cast<unsigned>(r);
+        }
+    };
+};
+#else
+struct AsyncFileIO::Ring {
+    static std::unique_ptr<Ring> open(unsigned) { return nullptr; };
+};
+#endif
+
+AsyncFileIO::AsyncFileIO(Options options) {
+    options.queue_depth = std::max(1u, options.queue_depth);
+    if (!options.force_fallback) {
+        ring = Ring::open(options.queue_depth);
+    }
+#ifdef HAVE_IO_URING
+    if (ring) {
+        // never more in flight than the CQ holds, so completions cannot overflow
+        batch_limit = ring->sq_entries;
+        max_in_flight = ring->cq_entries;
+        reaper = joining_thread(&AsyncFileIO::reap_loop, this);
+        return;
+    }
+#endif
+    batch_limit = options.queue_depth;
+    max_in_flight = 2 * options.queue_depth;
+    pool = std::make_unique<ThreadPool>(std::max(1u, options.fallback_threads));
+}
+
+AsyncFileIO::~AsyncFileIO() {
+    drain();
+#ifdef HAVE_IO_URING
+    if (ring) {
+        std::lock_guard<std::mutex> lk(m_);
+        ring->prepare(nullptr);
+        ring->flush(1);
+    }
+#endif
+    // reaper joins here, then the pool drains and joins its workers
+}
+
+void AsyncFileIO::register_buffers(std::vector<iovec> bufs) {
+    std::lock_guard<std::mutex> lk(m_);
+    if (!buffers.empty()) {
+        throw std::logic_error("buffers are already registered");
+    }
+#ifdef HAVE_IO_URING
+    if (ring && syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, bufs.data(),
+                        static_cast<unsigned>(bufs.size())) < 0) {
+        throw std::system_error(errno, std::system_category(), "IORING_REGISTER_BUFFERS");
+    }
+#endif
+    buffers = std::move(bufs);
+}
+
+void *AsyncFileIO::fixed(unsigned buf_index, std::size_t buf_offset, std::size_t len) {
+    if (buf_index >= buffers.size() || buf_offset > buffers[buf_index].iov_len ||
+        len > buffers[buf_index].iov_len - buf_offset) {
+        throw std::out_of_range("request outside the registered buffer");
+    }
+    return static_cast<char *>(buffers[buf_index].iov_base) + buf_offset;
+}
+
+void AsyncFileIO::enqueue(std::unique_ptr<Op> op) {
+    std::unique_lock<std::mutex> lk(m_);
+    if (in_completion && in_flight >= max_in_flight) {
+        deferred.push_back(op.release());
+        return;
+    }
+    while (in_flight >= max_in_flight) {
+        submit_locked();
+        capacity_cv.wait(lk);
+    }
+    pending.push_back(op.release());
+    in_flight++;
+    if (pending.size() >= batch_limit) {
+        submit_locked();
+    }
+}
+
+void AsyncFileIO::submit() {
+    std::lock_guard<std::mutex> lk(m_);
+    submit_locked();
+}
+
+void AsyncFileIO::submit_locked() {
+#ifdef HAVE_IO_URING
+    if (ring) {
+        std::size_t done = 0;
+        while (done < pending.size()) {
+            const unsigned n = static_cast<unsigned>(
+                std::min<std::size_t>(ring->sq_space(), pending.size() - done));
+            for (unsigned i = 0; i < n; i++) {
+                ring->prepare(pending[done + i]);
+            }
+            ring->flush(n);
+            done += n;
+        }
+        pending.clear();
+        return;
+    }
+#endif
+    for (Op *op : pending) {
+        pool->execute([this, op] { finish(op, run_sync(*op)); });
+    }
+    pending.clear();
+}
+
+void AsyncFileIO::drain() {
+    std::unique_lock<std::mutex> lk(m_);
+    submit_locked();
+    capacity_cv.wait(lk, [this] { return in_flight == 0 && deferred.empty(); });
+}
+
+void AsyncFileIO::finish(Op *op, long result) {
+    in_completion = true;
+    op->complete(result);
+    in_completion = false;
+    delete op;
+    // notified under the lock: once in_flight reaches 0 the destructor may
+    // run and take capacity_cv with it
+    std::lock_guard<std::mutex> lk(m_);
+    in_flight--;
+    // deferred requests come first, in the order their callbacks issued them
+    if (!deferred.empty()) {
+        const std::size_t n = std::min(deferred.size(), max_in_flight - in_flight);
+        pending.insert(pending.end(), deferred.begin(), deferred.begin() + n);
+        deferred.erase(deferred.begin(), deferred.begin() + n);
+        in_flight += n;
+        submit_locked();
+    }
+    capacity_cv.notify_all();
+}
+
+long AsyncFileIO::run_sync(const Op &op) {
+    const std::size_t len = std::min(op.len, max_rw);
+    for (;;) {
+        const ssize_t r = (op.opcode == op_read || op.opcode == op_read_fixed)
+                              ? pread(op.fd, op.buf, len, op.offset)
+                              : pwrite(op.fd, op.buf, len, op.offset);
+        if (r >= 0) {
+            return static_cast<long>(r);
+        }
+        if (errno != EINTR) {
+            return -errno;
+        }
+    }
+}
+
+void AsyncFileIO::reap_loop() {
+#ifdef HAVE_IO_URING
+    for (bool stop = false; !stop;) {
+        if (ring->enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            throw std::system_error(errno, std::system_category(), "io_uring_enter");
+        }
+        unsigned head = *ring->cq_head;
+        const unsigned tail = std::atomic_ref<unsigned>(*ring->cq_tail).load(std::memory_order_acquire);
+        while (head != tail) {
+            const io_uring_cqe cqe = ring->cqes[head & *ring->cq_mask];
+            // the slot goes back to the kernel before the completion runs,
+            // so whatever that completion submits always finds room
+            std::atomic_ref<unsigned>(*ring->cq_head).store(++head, std::memory_order_release);
+            if (cqe.user_data == 0) {
+                stop = true;
+            } else {
+                finish(reinterpret_cast<Op *>(cqe.user_data), cqe.res);
+            }
+        }
+    }
+#endif
+}
@@ -0,0 +1,177 @@
+#ifndef __ASYNC_FILE_IO_H__
+#define __ASYNC_FILE_IO_H__
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "continuable-future.h"
+#include "joining-thread.h"
+#include "thread-pool.h"
+
+// Asynchronous pread/pwrite on local files. On Linux 5.6+ requests go
+// through an io_uring: no thread waits on any one read, and completions
+// are reaped by a single thread. Elsewhere, or when io_uring cannot be
+// set up, the same requests run as pread/pwrite on a small ThreadPool.
+//
+// Requests are queued and only issued by submit(), so a batch of them
+// costs one io_uring_enter:
+//
+//     AsyncFileIO io;
+//     for (auto &f : files) {
+//         io.read(f.fd, f.buf, f.size, 0, [&](long n) { ... });
+//     }
+//     io.submit();
+//
+// Callbacks get the byte count (which may be short) or -errno, and run on
+// the completion thread, so they should be brief; hand longer work to an
+// executor, e.g. through the Future overloads and then(ex, f). A callback
+// may issue more requests; past capacity they are held back and submitted
+// by later completions. Buffers must stay valid until their request
+// completes.
+class AsyncFileIO {
+    public:
+        struct Options {
+            // submission queue entries; also bounds how many are batched
+            unsigned queue_depth = 256;
+            unsigned fallback_threads = 4;
+            bool force_fallback = false;
+        };
+
+    private:
+        enum Opcode { op_read, op_write, op_read_fixed, op_write_fixed };
+        struct Op {
+            Opcode opcode = op_read;
+            int fd = -1;
+            void *buf = nullptr;
+            std::size_t len = 0;
+            off_t offset = 0;
+            // registered buffer index, or -1
+            int buf_index = -1;
+            virtual ~Op() = default;
+            virtual void complete(long result) = 0;
+        };
+        template<typename F>
+        struct OpImpl : Op {
+            F f;
+            explicit OpImpl(F &&f) : f(std::move(f)) {};
+            void complete(long result) override { f(result); };
+        };
+        struct Ring;
+
+        std::unique_ptr<Ring> ring;
+        std::unique_ptr<ThreadPool> pool;
+        std::vector<iovec> buffers;
+        std::mutex m_;
+        std::condition_variable capacity_cv;
+        std::vector<Op *> pending;
+        // issued by completion callbacks while at capacity; a callback
+        // cannot wait for room, so these join pending as completions free it
+        std::vector<Op *> deferred;
+        // queued or submitted, not yet completed
+        std::size_t in_flight = 0;
+        std::size_t max_in_flight;
+        std::size_t batch_limit;
+        joining_thread reaper;
+
+        void enqueue(std::unique_ptr<Op> op);
+        void submit_locked();
+        void finish(Op *op, long result);
+        void reap_loop();
+        static long run_sync(const Op &op);
+
+        template<typename F>
+        void add(Opcode opcode, int fd, void *buf, std::size_t len, off_t offset, int buf_index,
+                 F &&on_done) {
+            auto op = std::make_unique<OpImpl<std::decay_t<F>>>(std::decay_t<F>(std::forward<F>(on_done)));
+            op->opcode = opcode;
+            op->fd = fd;
+            op->buf = buf;
+            op->len = len;
+            op->offset = offset;
+            op->buf_index = buf_index;
+            enqueue(std::move(op));
+        };
+        void *fixed(unsigned buf_index, std::size_t buf_offset, std::size_t len);
+        template<typename Issue>
+        static Future<std::size_t> as_future(Issue &&issue) {
+            Promise<std::size_t> p;
+            auto f = p.get_future();
+            issue([p = std::move(p)](long result) mutable {
+                if (result < 0) {
+                    p.set_exception(std::make_exception_ptr(
+                        std::system_error(static_cast<int>(-result), std::system_category())));
+                } else {
+                    p.set_value(static_cast<std::size_t>(result));
+                }
+            });
+            return f;
+        };
+
+    public:
+        explicit AsyncFileIO(Options options);
+        AsyncFileIO() : AsyncFileIO(Options()) {};
+        AsyncFileIO(const AsyncFileIO &other) = delete;
+        AsyncFileIO &operator=(const AsyncFileIO &other) = delete;
+        // submits whatever is queued and waits for all of it to complete
+        ~AsyncFileIO();
+
+        bool uses_io_uring() const { return ring != nullptr; };
+
+        // Pins these buffers for the *_fixed calls, which then skip the
+        // per-request page mapping. Allowed once, before any fixed request.
+        void register_buffers(std::vector<iovec> bufs);
+
+        template<typename F>
+        void read(int fd, void *buf, std::size_t len, off_t offset, F &&on_done) {
+            add(op_read, fd, buf, len, offset, -1, std::forward<F>(on_done));
+        };
+        template<typename F>
+        void write(int fd, const void *buf, std::size_t len, off_t offset, F &&on_done) {
+            add(op_write, fd, const_cast<void *>(buf), len, offset, -1, std::forward<F>(on_done));
+        };
+        // len bytes at buf_offset within registered buffer buf_index
+        template<typename F>
+        void read_fixed(int fd, unsigned buf_index, std::size_t buf_offset, std::size_t len,
+                        off_t offset, F &&on_done) {
+            add(op_read_fixed, fd, fixed(buf_index, buf_offset, len), len, offset,
+                static_cast<int>(buf_index), std::forward<F>(on_done));
+        };
+        template<typename F>
+        void write_fixed(int fd, unsigned buf_index, std::size_t buf_offset, std::size_t len,
+                         off_t offset, F &&on_done) {
+            add(op_write_fixed, fd, fixed(buf_index, buf_offset, len), len, offset,
+                static_cast<int>(buf_index), std::forward<F>(on_done));
+        };
+
+        // the same requests, failing their futures with std::system_error
+        Future<std::size_t> read(int fd, void *buf, std::size_t len, off_t offset) {
+            return as_future([&](auto cb) { read(fd, buf, len, offset, std::move(cb)); });
+        };
+        Future<std::size_t> write(int fd, const void *buf, std::size_t len, off_t offset) {
+            return as_future([&](auto cb) { write(fd, buf, len, offset, std::move(cb)); });
+        };
+        Future<std::size_t> read_fixed(int fd, unsigned buf_index, std::size_t buf_offset,
+                                       std::size_t len, off_t offset) {
+            return as_future([&](auto cb) {
+                read_fixed(fd, buf_index, buf_offset, len, offset, std::move(cb));
+            });
+        };
+        Future<std::size_t> write_fixed(int fd, unsigned buf_index, std::size_t buf_offset,
+                                        std::size_t len, off_t offset) {
+            return as_future([&](auto cb) {
+                write_fixed(fd, buf_index, buf_offset, len, offset, std::move(cb));
+            });
+        };
+
+        // issues every queued request at once
+        void submit();
+        // submits and blocks until nothing is in flight
+        void drain();
+};
+#endif // __ASYNC_FILE_IO_H__
@@ -0,0 +1,499 @@
+#ifndef __CONTINUABLE_FUTURE_H__
+#define __CONTINUABLE_FUTURE_H__
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Future/Promise whose consumer attaches what to do next instead of
+// blocking a thread in get():
+//
+//     Future<Reply> r = fetch(id).then(pool, [](Row row) { return render(row); });
+//     when_all(std::move(parts)).then([](std::vector<Part> ps) { ... });
+//
+// A continuation runs once the value is set, on the executor it was
+// attached with (by default inline, on the thread that completes the
+// promise). An exception, thrown by a continuation or set on a promise,
+// skips every continuation after it and comes out of get(). Like
+// std::future, a Future has one consumer: then() and get() consume it.
+
+// move-only type-erased void(), so continuations can own move-only state
+class Job {
+    private:
+        struct Base {
+            virtual ~Base() = default;
+            virtual void run() = 0;
+        };
+        template<typename F>
+        struct Impl : Base {
+            F f;
+            explicit Impl(F &&f) : f(std::move(f)) {};
+            void run() override { f(); };
+        };
+        std::unique_ptr<Base> impl;
+
+    public:
+        Job() = default;
+        template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Job>>>
+        Job(F &&f) : impl(std::make_unique<Impl<std::decay_t<F>>>(std::forward<F>(f))) {};
+        void operator()() { impl->run(); };
+        explicit operator bool() const { return impl != nullptr; };
+};
+
+// where continuations run; execute() must eventually call job exactly once
+class Executor {
+    public:
+        virtual ~Executor() = default;
+        virtual void execute(Job job) = 0;
+};
+
+class InlineExecutor final : public Executor {
+    public:
+        void execute(Job job) override { job(); };
+        static InlineExecutor &instance() {
+            static InlineExecutor ex;
+            return ex;
+        };
+};
+
+// adapts anything with a fire-and-forget execute(F), such as ThreadPool
+template<typename Pool>
+class PoolExecutor final : public Executor {
+    private:
+        Pool &pool;
+
+    public:
+        explicit PoolExecutor(Pool &pool) : pool(pool) {};
+        void execute(Job job) override { pool.execute(std::move(job)); };
+};
+
+// stands in for the value of a Future<void> inside tuples and shared state
+struct Unit {};
+template<typename T>
+using future_value_t = std::conditional_t<std::is_void_v<T>, Unit, T>;
+
+template<typename T> class Future;
+template<typename T> class Promise;
+
+template<typename T>
+class FutureState {
+    private:
+        std::mutex m_;
+        std::condition_variable ready_cv;
+        bool ready = false;
+        Executor *executor = nullptr;
+        Job continuation;
+
+    public:
+        // written once before ready is set, read only after it is seen
+        std::optional<future_value_t<T>> value;
+        std::exception_ptr error;
+
+        template<typename Set>
+        bool complete(Set &&set) {
+            Job next;
+            {
+                std::lock_guard<std::mutex> lk(m_);
+                if (ready) {
+                    return false;
+                }
+                set();
+                ready = true;
+                next = std::move(continuation);
+            }
+            ready_cv.notify_all();
+            if (next) {
+                executor->execute(std::move(next));
+            }
+            return true;
+        };
+        void on_ready(Executor &ex, Job job) {
+            {
+                std::lock_guard<std::mutex> lk(m_);
+                if (!ready) {
+                    executor = &ex;
+                    continuation = std::move(job);
+                    return;
+                }
+            }
+            ex.execute(std::move(job));
+        };
+        bool is_ready() {
+            std::lock_guard<std::mutex> lk(m_);
+            return ready;
+        };
+        void wait() {
+            std::unique_lock<std::mutex> lk(m_);
+            ready_cv.wait(lk, [this] { return ready; });
+        };
+};
+
+template<typename T> struct is_future : std::false_type {};
+template<typename T> struct is_future<Future<T>> : std::true_type {};
+// then(f) where f returns Future<U> yields Future<U>, not Future<Future<U>>
+template<typename R> struct unwrap_future { using type = R; };
+template<typename U> struct unwrap_future<Future<U>> { using type = U; };
+
+template<typename T>
+class Promise {
+    private:
+        std::shared_ptr<FutureState<T>> state;
+        bool retrieved = false;
+
+        template<typename Set>
+        void complete(Set &&set) {
+            if (!state) {
+                throw std::future_error(std::future_errc::no_state);
+            }
+            if (!state->complete(std::forward<Set>(set))) {
+                throw std::future_error(std::future_errc::promise_already_satisfied);
+            }
+        };
+
+    public:
+        Promise() : state(std::make_shared<FutureState<T>>()) {};
+        Promise(Promise &&other) = default;
+        Promise &operator=(Promise &&other) = default;
+        Promise(const Promise &other) = delete;
+        Promise &operator=(const Promise &other) = delete;
+        // a promise dropped unset fails its future instead of leaving it hanging
+        ~Promise() {
+            if (state) {
+                auto e = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+                state->complete([&] { state->error = e; });
+            }
+        };
+
+        Future<T> get_future() {
+            if (!state) {
+                throw std::future_error(std::future_errc::no_state);
+            }
+            if (retrieved) {
+                throw std::future_error(std::future_errc::future_already_retrieved);
+            }
+            retrieved = true;
+            return Future<T>(state);
+        };
+
+        template<typename U = T, typename = std::enable_if_t<!std::is_void_v<U>>>
+        void set_value(U &&value) {
+            complete([&] { state->value.emplace(std::forward<U>(value)); });
+        };
+        template<typename U = T, typename = std::enable_if_t<std::is_void_v<U>>>
+        void set_value() {
+            complete([&] { state->value.emplace(); });
+        };
+        void set_exception(std::exception_ptr e) {
+            complete([&] { state->error = e; });
+        };
+};
+
+template<typename T>
+class Future {
+    private:
+        template<typename> friend class Promise;
+        template<typename> friend class Future;
+        std::shared_ptr<FutureState<T>> state;
+
+        explicit Future(std::shared_ptr<FutureState<T>> state) : state(std::move(state)) {};
+
+        std::shared_ptr<FutureState<T>> take() {
+            if (!state) {
+                throw std::future_error(std::future_errc::no_state);
+            }
+            return std::move(state);
+        };
+
+        // completes p with whatever this future ends up holding
+        void forward_to(Promise<T> p) && {
+            std::move(*this).on_complete([p = std::move(p)](Future<T> f) mutable {
+                try {
+                    if constexpr (std::is_void_v<T>) {
+                        f.get();
+                        p.set_value();
+                    } else {
+                        p.set_value(f.get());
+                    }
+                } catch (...) {
+                    p.set_exception(std::current_exception());
+                }
+            });
+        };
+
+    public:
+        Future() = default;
+        Future(Future &&other) = default;
+        Future &operator=(Future &&other) = default;
+        Future(const Future &other) = delete;
+        Future &operator=(const Future &other) = delete;
+
+        bool valid() const { return state != nullptr; };
+        bool ready() const { return state && state->is_ready(); };
+        // blocks; prefer then() anywhere a thread should not be tied up
+        void wait() const {
+            if (!state) {
+                throw std::future_error(std::future_errc::no_state);
+            }
+            state->wait();
+        };
+        T get() {
+            auto s = take();
+            s->wait();
+            if (s->error) {
+                std::rethrow_exception(s->error);
+            }
+            if constexpr (!std::is_void_v<T>) {
+                return std::move(*s->value);
+            }
+        };
+
+        // f(T&&) -> R, or f() for Future<void>; runs on ex once this is ready
+        template<typename F>
+        auto then(Executor &ex, F f) && {
+            using R = std::conditional_t<std::is_void_v<T>, std::invoke_result<F &>,
+                                         std::invoke_result<F &, future_value_t<T> &&>>;
+            using Result = typename R::type;
+            using Next = typename unwrap_future<Result>::type;
+            Promise<Next> p;
+            Future<Next> next = p.get_future();
+            auto s = take();
+            s->on_ready(ex, [s, p = std::move(p), f = std::move(f)]() mutable {
+                if (s->error) {
+                    p.set_exception(s->error);
+                    return;
+                }
+                try {
+                    auto call = [&]() -> Result {
+                        if constexpr (std::is_void_v<T>) {
+                            return f();
+                        } else {
+                            return f(std::move(*s->value));
+                        }
+                    };
+                    if constexpr (is_future<Result>::value) {
+                        call().forward_to(std::move(p));
+                    } else if constexpr (std::is_void_v<Result>) {
+                        call();
+                        p.set_value();
+                    } else {
+                        p.set_value(call());
+                    }
+                } catch (...) {
+                    p.set_exception(std::current_exception());
+                }
+            });
+            return next;
+        };
+        template<typename F>
+        auto then(F f) && {
+            return std::move(*this).then(InlineExecutor::instance(), std::move(f));
+        };
+        // f(Future<T>) with this future once it is ready, value or exception;
+        // get() inside f does not block
+        template<typename F>
+        void on_complete(Executor &ex, F f) && {
+            auto s = take();
+            s->on_ready(ex, [s, f = std::move(f)]() mutable { f(Future<T>(s)); });
+        };
+        template<typename F>
+        void on_complete(F f) && {
+            std::move(*this).on_complete(InlineExecutor::instance(), std::move(f));
+        };
+};
+
+template<typename T>
+Future<std::decay_t<T>> make_ready_future(T &&value) {
+    Promise<std::decay_t<T>> p;
+    p.set_value(std::forward<T>(value));
+    return p.get_future();
+}
+
+inline Future<void> make_ready_future() {
+    Promise<void> p;
+    p.set_value();
+    return p.get_future();
+}
+
+template<typename T>
+Future<T> make_exceptional_future(std::exception_ptr e) {
+    Promise<T> p;
+    p.set_exception(e);
+    return p.get_future();
+}
+
+// runs f() on ex and returns its eventual result
+template<typename F>
+auto async_on(Executor &ex, F f) {
+    return make_ready_future().then(ex, std::move(f));
+}
+
+// Ready once every input is; fails with the first exception to arrive
+// without waiting for the rest. Future<void> inputs yield Future<void>.
+template<typename T>
+auto when_all(std::vector<Future<T>> futures) {
+    using R = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+    struct Shared {
+        std::mutex m_;
+        std::vector<std::optional<future_value_t<T>>> values;
+        std::size_t remaining;
+        Promise<R> p;
+    };
+    auto shared = std::make_shared<Shared>();
+    Future<R> result = shared->p.get_future();
+    shared->values.resize(futures.size());
+    shared->remaining = futures.size();
+    if (futures.empty()) {
+        if constexpr (std::is_void_v<T>) {
+            shared->p.set_value();
+        } else {
+            shared->p.set_value(std::vector<T>());
+        }
+        return result;
+    }
+    for (std::size_t i = 0; i < futures.size(); i++) {
+        std::move(futures[i]).on_complete([shared, i](Future<T> f) {
+            std::exception_ptr error;
+            std::optional<future_value_t<T>> v;
+            try {
+                if constexpr (std::is_void_v<T>) {
+                    f.get();
+                    v.emplace();
+                } else {
+                    v.emplace(f.get());
+                }
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::unique_lock<std::mutex> lk(shared->m_);
+            if (shared->remaining == 0) {
+                return;
+            }
+            if (error) {
+                shared->remaining = 0;
+                lk.unlock();
+                shared->p.set_exception(error);
+                return;
+            }
+            shared->values[i] = std::move(v);
+            if (--shared->remaining != 0) {
+                return;
+            }
+            lk.unlock();
+            if constexpr (std::is_void_v<T>) {
+                shared->p.set_value();
+            } else {
+                std::vector<T> out;
+                out.reserve(shared->values.size());
+                for (auto &value : shared->values) {
+                    out.push_back(std::move(*value));
+                }
+                shared->p.set_value(std::move(out));
+            }
+        });
+    }
+    return result;
+}
+
+// Same over differently typed inputs; void inputs contribute a Unit.
+template<typename... Ts>
+Future<std::tuple<future_value_t<Ts>...>> when_all(Future<Ts>... futures) {
+    using Tuple = std::tuple<future_value_t<Ts>...>;
+    struct Shared {
+        std::mutex m_;
+        std::tuple<std::optional<future_value_t<Ts>>...> values;
+        std::size_t remaining = sizeof...(Ts);
+        Promise<Tuple> p;
+    };
+    auto shared = std::make_shared<Shared>();
+    Future<Tuple> result = shared->p.get_future();
+    if constexpr (sizeof...(Ts) == 0) {
+        shared->p.set_value(Tuple());
+    }
+    auto attach = [&shared]<std::size_t I, typename T>(Future<T> future) {
+        std::move(future).on_complete([shared](Future<T> f) {
+            std::exception_ptr error;
+            std::optional<future_value_t<T>> v;
+            try {
+                if constexpr (std::is_void_v<T>) {
+                    f.get();
+                    v.emplace();
+                } else {
+                    v.emplace(f.get());
+                }
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::unique_lock<std::mutex> lk(shared->m_);
+            if (shared->remaining == 0) {
+                return;
+            }
+            if (error) {
+                shared->remaining = 0;
+                lk.unlock();
+                shared->p.set_exception(error);
+                return;
+            }
+            std::get<I>(shared->values) = std::move(v);
+            if (--shared->remaining != 0) {
+                return;
+            }
+            lk.unlock();
+            shared->p.set_value(std::apply(
+                [](auto &...value) { return Tuple(std::move(*value)...); }, shared->values));
+        });
+    };
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        (attach.template operator()<I>(std::move(futures)), ...);
+    }(std::index_sequence_for<Ts...>());
+    return result;
+}
+
+// Ready with the index and value of the first input to complete, or with
+// its exception if it failed. Future<void> inputs yield just the index.
+template<typename T>
+auto when_any(std::vector<Future<T>> futures) {
+    using R = std::conditional_t<std::is_void_v<T>, std::size_t, std::pair<std::size_t, T>>;
+    if (futures.empty()) {
+        return make_exceptional_future<R>(
+            std::make_exception_ptr(std::invalid_argument("when_any of no futures")));
+    }
+    struct Shared {
+        std::mutex m_;
+        bool done = false;
+        Promise<R> p;
+    };
+    auto shared = std::make_shared<Shared>();
+    Future<R> result = shared->p.get_future();
+    for (std::size_t i = 0; i < futures.size(); i++) {
+        std::move(futures[i]).on_complete([shared, i](Future<T> f) {
+            {
+                // only the first completion lands
+                std::lock_guard<std::mutex> lk(shared->m_);
+                if (shared->done) {
+                    return;
+                }
+                shared->done = true;
+            }
+            try {
+                if constexpr (std::is_void_v<T>) {
+                    f.get();
+                    shared->p.set_value(i);
+                } else {
+                    shared->p.set_value(R(i, f.get()));
+                }
+            } catch (...) {
+                shared->p.set_exception(std::current_exception());
+            }
+        });
+    }
+    return result;
+}
+#endif // __CONTINUABLE_FUTURE_H__
@@ -0,0 +1,119 @@
+#include "continuable-future.h"
+#include "thread-pool.h"
+#include <atomic>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+// A backend that answers requests from a single I/O thread. Callers get a
+// Future back and never park a thread of their own waiting for the reply.
+class Backend {
+    private:
+        ThreadsafeQueue<std::pair<int, Promise<int>>> requests;
+        joining_thread io;
+
+    public:
+        Backend() : io([this] {
+            for (;;) {
+                auto [key, reply] = std::move(*requests.wait_and_pop());
+                if (key < 0) {
+                    return;
+                }
+                if (key == 13) {
+                    reply.set_exception(std::make_exception_ptr(std::runtime_error("unlucky")));
+                } else {
+                    reply.set_value(key * 2);
+                }
+            }
+        }) {};
+        ~Backend() { requests.push({-1, Promise<int>()}); };
+        Future<int> fetch(int key) {
+            Promise<int> p;
+            auto f = p.get_future();
+            requests.push({key, std::move(p)});
+            return f;
+        };
+};
+
+int main() {
+    ThreadPool pool(2);
+    PoolExecutor<ThreadPool> ex(pool);
+    Backend backend;
+
+    // fan out 1000 dependent requests; each reply is post-processed on the
+    // pool and the sum is assembled when the last one lands
+    const int n = 1000;
+    std::vector<Future<int>> replies;
+    for (int i = 0; i < n; i++) {
+        replies.push_back(backend.fetch(i == 13 ? 12 : i).then(ex, [](int v) { return v + 1; }));
+    }
+    auto total = when_all(std::move(replies)).then(ex, [](std::vector<int> vs) {
+        long sum = 0;
+        for (int v : vs) {
+            sum += v;
+        }
+        return sum;
+    });
+    const long summed = total.get();
+    assert(summed == static_cast<long>(n) * (n - 1) + n - 2);
+
+    // a continuation returning a Future is flattened, so dependent calls chain
+    auto chained = backend.fetch(1).then([&](int v) { return backend.fetch(v); })
+                       .then(ex, [](int v) { return std::to_string(v); });
+    const std::string fetched = chained.get();
+    assert(fetched == "4");
+
+    // an exception skips the rest of the chain and surfaces in get()
+    std::atomic<bool> ran{false};
+    auto failed = backend.fetch(13).then([&](int v) {
+        ran = true;
+        return v;
+    });
+    try {
+        failed.get();
+        assert(false);
+    } catch (const std::runtime_error &e) {
+        assert(std::string(e.what()) == "unlucky");
+    }
+    assert(!ran);
+
+    // ... and fails when_all without waiting for the other inputs
+    Promise<int> never;
+    std::vector<Future<int>> mixed;
+    mixed.push_back(never.get_future());
+    mixed.push_back(backend.fetch(13));
+    try {
+        when_all(std::move(mixed)).get();
+        assert(false);
+    } catch (const std::runtime_error &) {
+    }
+
+    // when_any takes the first reply
+    Promise<int> slow;
+    std::vector<Future<int>> race;
+    race.push_back(slow.get_future());
+    race.push_back(backend.fetch(21));
+    auto [index, value] = when_any(std::move(race)).get();
+    assert(index == 1 && value == 42);
+    slow.set_value(0);
+
+    // mixed types, including void
+    auto [a, unit, s] = when_all(backend.fetch(5), async_on(ex, [] {}),
+                                 async_on(ex, [] { return std::string("ok"); }))
+                            .get();
+    assert(a == 10 && s == "ok");
+    (void)unit;
+
+    // a dropped promise breaks its future rather than hanging it
+    Future<void> orphan = Promise<void>().get_future();
+    try {
+        orphan.get();
+        assert(false);
+    } catch (const std::future_error &e) {
+        assert(e.code() == std::future_errc::broken_promise);
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+#ifndef __BOUNDED_QUEUE_H__
+#define __BOUNDED_QUEUE_H__
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Blocking queue with a fixed capacity: producers wait while it is full,
+// which is what pushes backpressure up a pipeline. Values are only ever
+// moved. close() ends the stream; consumers drain what is left and then
+// see end-of-stream, while cancel() also drops whatever is queued.
+template<typename T>
+class BoundedQueue {
+    private:
+        mutable std::mutex m_;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        std::deque<T> q;
+        const std::size_t capacity;
+        bool closed = false;
+
+    public:
+        explicit BoundedQueue(std::size_t capacity) : capacity(std::max<std::size_t>(1, capacity)) {};
+        BoundedQueue(const BoundedQueue &other) = delete;
+        BoundedQueue &operator=(const BoundedQueue &other) = delete;
+
+        // blocks while full; false once the queue is closed
+        bool push(T &&value) {
+            std::unique_lock<std::mutex> lk(m_);
+            not_full.wait(lk, [this] { return closed || q.size() < capacity; });
+            if (closed) {
+                return false;
+            }
+            q.push_back(std::move(value));
+            lk.unlock();
+            not_empty.notify_one();
+            return true;
+        };
+
+        // moves all of values in, taking as much as fits per lock
+        // acquisition; values is left empty. False once the queue is closed.
+        bool push_bulk(std::vector<T> &values) {
+            std::size_t i = 0;
+            while (i < values.size()) {
+                std::unique_lock<std::mutex> lk(m_);
+                not_full.wait(lk, [this] { return closed || q.size() < capacity; });
+                if (closed) {
+                    values.clear();
+                    return false;
+                }
+                const std::size_t n = std::min(values.size() - i, capacity - q.size());
+                for (std::size_t end = i + n; i < end; i++) {
+                    q.push_back(std::move(values[i]));
+                }
+                lk.unlock();
+                if (n == 1) {
+                    not_empty.notify_one();
+                } else {
+                    not_empty.notify_all();
+                }
+            }
+            values.clear();
+            return true;
+        };
+
+        // blocks until a value is available; appends up to max_n values to
+        // out and returns how many, 0 meaning closed and drained
+        std::size_t pop_bulk(std::vector<T> &out, std::size_t max_n) {
+            std::unique_lock<std::mutex> lk(m_);
+            not_empty.wait(lk, [this] { return closed || !q.empty(); });
+            const std::size_t n = std::min(max_n, q.size());
+            for (std::size_t i = 0; i < n; i++) {
+                out.push_back(std::move(q.front()));
+                q.pop_front();
+            }
+            lk.unlock();
+            if (n == 1) {
+                not_full.notify_one();
+            } else if (n > 1) {
+                not_full.notify_all();
+            }
+            return n;
+        };
+        bool pop(T &out) {
+            std::unique_lock<std::mutex> lk(m_);
+            not_empty.wait(lk, [this] { return closed || !q.empty(); });
+            if (q.empty()) {
+                return false;
+            }
+            out = std::move(q.front());
+            q.pop_front();
+            lk.unlock();
+            not_full.notify_one();
+            return true;
+        };
+
+        void close() {
+            {
+                std::lock_guard<std::mutex> lk(m_);
+                closed = true;
+            }
+            not_empty.notify_all();
+            not_full.notify_all();
+        };
+        void cancel() {
+            std::deque<T> dropped;
+            {
+                std::lock_guard<std::mutex> lk(m_);
+                closed = true;
+                dropped.swap(q);
+            }
+            not_empty.notify_all();
+            not_full.notify_all();
+        };
+
+        std::size_t size() const {
+            std::lock_guard<std::mutex> lk(m_);
+            return q.size();
+        };
+};
+#endif // __BOUNDED_QUEUE_H__
@@ -0,0 +1,78 @@
+#include "Data.h"
+#include "pipeline.h"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+int main() {
+    // produce -> process (4 workers) -> extract id (2 workers) -> sum (1 sink)
+    const int n = 20000;
+    std::atomic<long long> sum{0};
+    std::atomic<int> in_flight{0}, max_in_flight{0};
+    const std::size_t capacity = 64;
+    auto pipeline = Pipeline<Data>(capacity, 16)
+                        .then(4, [](Data d) {
+                            d.process();
+                            return d;
+                        })
+                        .then(2, [](Data d) { return d.get_id(); })
+                        .then(1, [&](int id) {
+                            sum += id;
+                            in_flight--;
+                            // a slow consumer: the producer must be held back
+                            if (id % 1000 == 0) {
+                                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                            }
+                        });
+    for (int i = 0; i < n; i++) {
+        int now = ++in_flight;
+        for (int m = max_in_flight; now > m && !max_in_flight.compare_exchange_weak(m, now);) {
+        }
+        const bool ok = pipeline.push(Data(i, std::to_string(i)));
+        assert(ok);
+    }
+    pipeline.wait();
+    assert(sum == static_cast<long long>(n) * (n - 1) / 2);
+    // three queues plus what the workers hold in their batches
+    assert(max_in_flight <= static_cast<int>(3 * capacity + 7 * 16 + 1));
+    const bool pushed_after_wait = pipeline.push(Data());
+    assert(!pushed_after_wait);
+
+    // results can be read from the last queue instead of a sink
+    auto squares = Pipeline<int>(8).then(2, [](int x) { return x * x; });
+    std::thread feeder([&] {
+        for (int i = 1; i <= 100; i++) {
+            squares.push(int(i));
+        }
+        squares.close();
+    });
+    long long total = 0;
+    for (int x; squares.pop(x);) {
+        total += x;
+    }
+    feeder.join();
+    squares.wait();
+    assert(total == 100LL * 101 * 201 / 6);
+
+    // an exception in a stage cancels the pipeline and surfaces in wait()
+    auto failing = Pipeline<int>(4).then(2, [](int x) {
+                                        if (x == 50) {
+                                            throw std::runtime_error("bad record");
+                                        }
+                                        return x;
+                                    })
+                       .then(1, [](int) {});
+    for (int i = 0; i < 1000 && failing.push(int(i)); i++) {
+    }
+    bool thrown = false;
+    try {
+        failing.wait();
+    } catch (const std::runtime_error &e) {
+        thrown = std::string(e.what()) == "bad record";
+    }
+    assert(thrown);
+    return 0;
+}
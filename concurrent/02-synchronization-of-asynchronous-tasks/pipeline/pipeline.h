@@ -0,0 +1,255 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "bounded-queue.h"
+#include "joining-thread.h"
+
+// State shared by every stage of one pipeline: the first error thrown by
+// any stage, and how to cancel every queue once it has happened.
+class PipelineState {
+    private:
+        std::mutex m_;
+        std::exception_ptr error;
+        std::vector<std::function<void()>> cancels;
+
+    public:
+        void on_cancel(std::function<void()> f) {
+            std::lock_guard<std::mutex> lk(m_);
+            cancels.push_back(std::move(f));
+        };
+        void cancel(std::exception_ptr e = nullptr) {
+            std::vector<std::function<void()>> fs;
+            {
+                std::lock_guard<std::mutex> lk(m_);
+                if (e && !error) {
+                    error = e;
+                }
+                fs = cancels;
+            }
+            for (auto &f : fs) {
+                f();
+            }
+        };
+        std::exception_ptr failure() {
+            std::lock_guard<std::mutex> lk(m_);
+            return error;
+        };
+};
+
+class PipelineStage {
+    public:
+        virtual ~PipelineStage() = default;
+        virtual void join() = 0;
+};
+
+// Chain of stages joined by BoundedQueues. Each stage runs f on its own
+// worker threads, taking up to batch values per queue operation and handing
+// the results on in one push; a full queue blocks the stage in front of it,
+// so a slow stage throttles the producer instead of buffering without
+// bound. With more than one worker a stage does not preserve order.
+//
+//     Pipeline<Data> p(256);
+//     auto run = std::move(p).then(4, [](Data d) { d.process(); return d; })
+//                            .then(1, [](Data d) { store(d); });
+//     run.push(Data()); ... run.wait();
+//
+// A stage whose f returns void ends the chain. Otherwise results are read
+// with pop(), which must keep up, or the last stage blocks on a full queue.
+template<typename In, typename Out = In>
+class Pipeline {
+    private:
+        template<typename, typename> friend class Pipeline;
+
+        template<typename A, typename B, typename F>
+        class Stage : public PipelineStage {
+            private:
+                std::shared_ptr<BoundedQueue<A>> in;
+                std::shared_ptr<BoundedQueue<B>> out;
+                std::shared_ptr<PipelineState> state;
+                F f;
+                const std::size_t batch;
+                std::atomic<unsigned> running;
+                std::vector<joining_thread> threads;
+
+                void work() {
+                    std::vector<A> items;
+                    std::vector<B> results;
+                    try {
+                        while (in->pop_bulk(items, batch) != 0) {
+                            for (auto &item : items) {
+                                results.push_back(f(std::move(item)));
+                            }
+                            items.clear();
+                            if (!out->push_bulk(results)) {
+                                break;
+                            }
+                        }
+                    } catch (...) {
+                        state->cancel(std::current_exception());
+                    }
+                    // the last worker out ends the stream for the next stage
+                    if (running.fetch_sub(1) == 1) {
+                        out->close();
+                    }
+                };
+
+            public:
+                Stage(std::shared_ptr<BoundedQueue<A>> in, std::shared_ptr<BoundedQueue<B>> out,
+                      std::shared_ptr<PipelineState> state, F f, unsigned workers, std::size_t batch)
+                    : in(std::move(in)), out(std::move(out)), state(std::move(state)),
+                      f(std::move(f)), batch(batch), running(workers) {
+                    for (unsigned i = 0; i < workers; i++) {
+                        threads.emplace_back(&Stage::work, this);
+                    }
+                };
+                void join() override {
+                    for (auto &t : threads) {
+                        t.join();
+                    }
+                };
+        };
+
+        template<typename A, typename F>
+        class Sink : public PipelineStage {
+            private:
+                std::shared_ptr<BoundedQueue<A>> in;
+                std::shared_ptr<PipelineState> state;
+                F f;
+                const std::size_t batch;
+                std::vector<joining_thread> threads;
+
+                void work() {
+                    std::vector<A> items;
+                    try {
+                        while (in->pop_bulk(items, batch) != 0) {
+                            for (auto &item : items) {
+                                f(std::move(item));
+                            }
+                            items.clear();
+                        }
+                    } catch (...) {
+                        state->cancel(std::current_exception());
+                    }
+                };
+
+            public:
+                Sink(std::shared_ptr<BoundedQueue<A>> in, std::shared_ptr<PipelineState> state, F f,
+                     unsigned workers, std::size_t batch)
+                    : in(std::move(in)), state(std::move(state)), f(std::move(f)), batch(batch) {
+                    for (unsigned i = 0; i < workers; i++) {
+                        threads.emplace_back(&Sink::work, this);
+                    }
+                };
+                void join() override {
+                    for (auto &t : threads) {
+                        t.join();
+                    }
+                };
+        };
+
+        std::size_t capacity;
+        std::size_t batch;
+        std::shared_ptr<PipelineState> state;
+        std::shared_ptr<BoundedQueue<In>> input;
+        // null once a sink has ended the chain
+        std::shared_ptr<BoundedQueue<Out>> output;
+        std::vector<std::unique_ptr<PipelineStage>> stages;
+        bool joined = false;
+
+        template<typename T>
+        std::shared_ptr<BoundedQueue<T>> make_queue() {
+            auto q = std::make_shared<BoundedQueue<T>>(capacity);
+            state->on_cancel([q] { q->cancel(); });
+            return q;
+        };
+
+        Pipeline(std::size_t capacity, std::size_t batch, std::shared_ptr<PipelineState> state,
+                 std::shared_ptr<BoundedQueue<In>> input, std::shared_ptr<BoundedQueue<Out>> output,
+                 std::vector<std::unique_ptr<PipelineStage>> stages)
+            : capacity(capacity), batch(batch), state(std::move(state)), input(std::move(input)),
+              output(std::move(output)), stages(std::move(stages)) {};
+
+        void join_all() {
+            if (joined) {
+                return;
+            }
+            joined = true;
+            // each stage closes its output as it finishes, so joining front
+            // to back waits for the drain to ripple through
+            for (auto &s : stages) {
+                s->join();
+            }
+        };
+
+    public:
+        // capacity bounds every inter-stage queue, batch is the most values
+        // a worker moves per queue operation
+        explicit Pipeline(std::size_t capacity = 1024, std::size_t batch = 32)
+            : capacity(capacity), batch(std::max<std::size_t>(1, batch)),
+              state(std::make_shared<PipelineState>()) {
+            static_assert(std::is_same_v<In, Out>, "a new pipeline has no stages yet");
+            input = make_queue<In>();
+            output = input;
+        };
+        Pipeline(Pipeline &&other) = default;
+        Pipeline(const Pipeline &other) = delete;
+        Pipeline &operator=(const Pipeline &other) = delete;
+        // abandons whatever is still in flight; call wait() to drain instead
+        ~Pipeline() {
+            if (state && !stages.empty() && !joined) {
+                state->cancel();
+                join_all();
+            }
+        };
+
+        // appends a stage of workers threads running f(Out&&); the stages
+        // built so far move into the returned pipeline
+        template<typename F, typename O = Out>
+        auto then(unsigned workers, F f) && -> Pipeline<In, std::invoke_result_t<F &, O &&>> {
+            using R = std::invoke_result_t<F &, O &&>;
+            workers = std::max(1u, workers);
+            if constexpr (std::is_void_v<R>) {
+                stages.push_back(std::make_unique<Sink<Out, F>>(output, state, std::move(f), workers, batch));
+                return Pipeline<In, void>(capacity, batch, std::move(state), std::move(input), nullptr,
+                                          std::move(stages));
+            } else {
+                auto next = make_queue<R>();
+                stages.push_back(std::make_unique<Stage<Out, R, F>>(output, next, state, std::move(f),
+                                                                     workers, batch));
+                return Pipeline<In, R>(capacity, batch, std::move(state), std::move(input),
+                                       std::move(next), std::move(stages));
+            }
+        };
+
+        // blocks while the first queue is full; false after close() or a failure
+        bool push(In &&value) { return input->push(std::move(value)); };
+        bool push_bulk(std::vector<In> &values) { return input->push_bulk(values); };
+        // next result of the last stage; false once the pipeline has drained
+        template<typename T = Out, typename = std::enable_if_t<!std::is_void_v<T>>>
+        bool pop(T &value) { return output->pop(value); };
+
+        // no more input; stages finish what is queued and then stop
+        void close() { input->close(); };
+        // closes the input, waits for every stage to drain and rethrows the
+        // first exception any stage threw
+        void wait() {
+            close();
+            join_all();
+            if (auto e = state->failure()) {
+                std::rethrow_exception(e);
+            }
+        };
+        // drops everything queued and stops every stage
+        void cancel() { state->cancel(); };
+};
+#endif // __PIPELINE_H__
@@ -14,13 +14,14 @@ std::condition_variable que_not_empty;
 void prepare_data(int num_data) {
     while (num_data-- > 0) {
         auto data = Data();
+        const int id = data.get_id();
         std::this_thread::sleep_for(std::chrono::milliseconds(500));
         {
             std::lock_guard<std::mutex> guard(que_mutex);
-            data_que.push_back(data);
+            data_que.push_back(std::move(data));
         }
         std::cout << "thread: " << std::this_thread::get_id()
-                  << " produce data id: " << data.get_id()
+                  << " produce data id: " << id
                   << std::endl;
         que_not_empty.notify_one();
     }
@@ -31,7 +32,9 @@ void process_data() {
     while (true) {
         std::unique_lock<std::mutex> lk(que_mutex);
         que_not_empty.wait(lk, [&]{return !data_que.empty();});
-        auto &data = data_que.front(); data_que.pop_front();
+        // move out before pop_front, which destroys the front element
+        auto data = std::move(data_que.front());
+        data_que.pop_front();
         lk.unlock();
         data.process();
         std::this_thread::sleep_for(std::chrono::milliseconds(1000));
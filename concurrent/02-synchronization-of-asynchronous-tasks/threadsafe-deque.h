@@ -1,51 +1,100 @@
 #ifndef __THREADSAVE_DEQUE_H__
 #define __THREADSAVE_DEQUE_H__
 #include <condition_variable>
+#include <cstddef>
 #include <queue>
 #include <mutex>
 #include <memory>
-template<typename E>
+#include <type_traits>
+// Mutex is any Lockable; anything other than std::mutex waits through
+// condition_variable_any.
+template<typename E, typename Mutex = std::mutex>
 class ThreadSafeQueue {
     private:
-        mutable std::mutex m_;
+        using CondVar = std::conditional_t<std::is_same_v<Mutex, std::mutex>,
+                                           std::condition_variable, std::condition_variable_any>;
+        mutable Mutex m_;
         std::queue<E> q;
-        std::condition_variable not_empty;
+        CondVar not_empty;
+
+        template<typename OutputIt>
+        std::size_t pop_bulk(OutputIt &out, std::size_t max_n) {
+            std::size_t n = 0;
+            for (; n < max_n && !q.empty(); ++n) {
+                *out++ = std::move(q.front());
+                q.pop();
+            }
+            return n;
+        };
     public:
         ThreadSafeQueue() {};
         ThreadSafeQueue(const ThreadSafeQueue &other) {
-            std::lock_guard<std::mutex> guard(other.m_);
+            std::lock_guard<Mutex> guard(other.m_);
             q = other.q;
         };
 
         virtual ~ThreadSafeQueue() noexcept = default;
 
         void push(const E &element) {
-            std::lock_guard<std::mutex> guard(m_);
+            std::lock_guard<Mutex> guard(m_);
             q.push(element);
             not_empty.notify_one();
         };
 
+        template<typename InputIt>
+        void push_bulk(InputIt first, InputIt last) {
+            std::size_t n = 0;
+            {
+                std::lock_guard<Mutex> guard(m_);
+                for (; first != last; ++first, ++n) {
+                    q.push(*first);
+                }
+            }
+            if (n == 1) {
+                not_empty.notify_one();
+            } else if (n > 1) {
+                not_empty.notify_all();
+            }
+        };
+
         std::shared_ptr<E> pop() {
-            std::lock_guard<std::mutex> guard(m_);
-            not_empty.wait(m_, [this]{ return !q.empty(); });
+            std::unique_lock<Mutex> lk(m_);
+            not_empty.wait(lk, [this]{ return !q.empty(); });
 
-            std::shared_ptr<E> ptr = std::shared_ptr<E>(q.front());
+            std::shared_ptr<E> ptr = std::make_shared<E>(std::move(q.front()));
             q.pop();
             return ptr;
         };
 
         bool try_pop(E *ptr) {
-            std::lock_guard<std::mutex> guard(m_);
+            std::lock_guard<Mutex> guard(m_);
             if (q.empty()) {
                 return false;
             }
-            ptr = &q.front();
+            *ptr = std::move(q.front());
             q.pop();
             return true;
         }
 
+        template<typename OutputIt>
+        std::size_t try_pop_bulk(OutputIt out, std::size_t max_n) {
+            std::lock_guard<Mutex> guard(m_);
+            return pop_bulk(out, max_n);
+        };
+
+        // blocks until at least one element is available
+        template<typename OutputIt>
+        std::size_t wait_and_pop_bulk(OutputIt out, std::size_t max_n) {
+            if (max_n == 0) {
+                return 0;
+            }
+            std::unique_lock<Mutex> lk(m_);
+            not_empty.wait(lk, [this]{ return !q.empty(); });
+            return pop_bulk(out, max_n);
+        };
+
         bool empty() const {
-            std::lock_guard<std::mutex> guard(m_);
+            std::lock_guard<Mutex> guard(m_);
             return q.empty();
         };
 };
@@ -0,0 +1,243 @@
+#ifndef __FAST_LOCKS_H__
+#define __FAST_LOCKS_H__
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Lockable types for critical sections of a few dozen nanoseconds, where
+// parking on every contended acquire costs far more than the section
+// itself. All of them can be passed as the Mutex parameter of
+// threadsafe_stack, ThreadSafeQueue and ThreadsafeQueue, and through
+// shared_as_exclusive as the stripe lock of ConcurrentHashMap.
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// spinning only pays off when the holder can run at the same time
+inline bool spinning_useful() {
+    static const bool useful = std::thread::hardware_concurrency() > 1;
+    return useful;
+}
+
+// Drepper's three-state futex mutex (0 free, 1 locked, 2 locked with
+// waiters) with an adaptive spin phase in front of FUTEX_WAIT, as in
+// glibc's PTHREAD_MUTEX_ADAPTIVE_NP: the spin budget tracks how long
+// recent acquisitions actually had to spin. Unlock only enters the kernel
+// when somebody is parked.
+class futex_mutex {
+    private:
+        static constexpr int max_spin = 1000;
+        std::atomic<std::uint32_t> state{0};
+        // estimate of spins needed; a hint, so relaxed and racy by design
+        std::atomic<int> spin_estimate{10};
+
+        void futex_wait(std::uint32_t expected) {
+            syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&state), FUTEX_WAIT_PRIVATE,
+                    expected, nullptr, nullptr, 0);
+        };
+        void futex_wake() {
+            syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&state), FUTEX_WAKE_PRIVATE, 1,
+                    nullptr, nullptr, 0);
+        };
+
+    public:
+        static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t),
+                      "futex word must be a plain 32-bit integer");
+        futex_mutex() = default;
+        futex_mutex(const futex_mutex &) = delete;
+        futex_mutex &operator=(const futex_mutex &) = delete;
+
+        bool try_lock() {
+            std::uint32_t c = 0;
+            return state.compare_exchange_strong(c, 1, std::memory_order_acquire,
+                                                 std::memory_order_relaxed);
+        };
+        void lock() {
+            if (try_lock()) {
+                return;
+            }
+            if (spinning_useful()) {
+                const int estimate = spin_estimate.load(std::memory_order_relaxed);
+                const int limit = std::min(max_spin, 2 * estimate + 10);
+                for (int spins = 1; spins <= limit; spins++) {
+                    cpu_relax();
+                    if (state.load(std::memory_order_relaxed) == 0 && try_lock()) {
+                        spin_estimate.store(estimate + (spins - estimate) / 8,
+                                            std::memory_order_relaxed);
+                        return;
+                    }
+                }
+                spin_estimate.store(estimate + (limit - estimate) / 8, std::memory_order_relaxed);
+            }
+            std::uint32_t c = state.exchange(2, std::memory_order_acquire);
+            while (c != 0) {
+                futex_wait(2);
+                c = state.exchange(2, std::memory_order_acquire);
+            }
+        };
+        void unlock() {
+            if (state.exchange(0, std::memory_order_release) == 2) {
+                futex_wake();
+            }
+        };
+};
+
+// FIFO: each acquirer takes a ticket and waits for now_serving to reach it,
+// so no thread can be overtaken. Waiters back off in proportion to their
+// distance from the head of the line, and yield once it is clear the
+// holder is not running.
+class ticket_lock {
+    private:
+        static constexpr int yield_after = 64;
+        alignas(64) std::atomic<std::uint32_t> next_ticket{0};
+        alignas(64) std::atomic<std::uint32_t> now_serving{0};
+
+    public:
+        ticket_lock() = default;
+        ticket_lock(const ticket_lock &) = delete;
+        ticket_lock &operator=(const ticket_lock &) = delete;
+
+        void lock() {
+            const std::uint32_t ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+            for (int rounds = 0;; rounds++) {
+                const std::uint32_t serving = now_serving.load(std::memory_order_acquire);
+                if (serving == ticket) {
+                    return;
+                }
+                if (!spinning_useful() || rounds >= yield_after) {
+                    std::this_thread::yield();
+                } else {
+                    for (std::uint32_t i = 0; i < (ticket - serving) * 16; i++) {
+                        cpu_relax();
+                    }
+                }
+            }
+        };
+        bool try_lock() {
+            std::uint32_t serving = now_serving.load(std::memory_order_relaxed);
+            std::uint32_t expected = serving;
+            return next_ticket.compare_exchange_strong(expected, serving + 1,
+                                                       std::memory_order_acquire,
+                                                       std::memory_order_relaxed);
+        };
+        void unlock() {
+            now_serving.store(now_serving.load(std::memory_order_relaxed) + 1,
+                              std::memory_order_release);
+        };
+};
+
+// Mellor-Crummey and Scott queue lock. Waiters form a linked list and each
+// spins on a flag in its own node, so a handoff touches one waiter's cache
+// line instead of every waiter's. Lockable has no per-acquire argument, so
+// nodes come from a small per-thread pool and the holder's node is
+// remembered in the lock until unlock.
+class mcs_lock {
+    private:
+        static constexpr int yield_after = 256;
+        struct alignas(64) qnode {
+            std::atomic<qnode *> next{nullptr};
+            std::atomic<bool> waiting{false};
+        };
+        struct node_pool {
+            std::vector<std::unique_ptr<qnode>> owned;
+            std::vector<qnode *> free;
+            qnode *get() {
+                if (free.empty()) {
+                    owned.push_back(std::make_unique<qnode>());
+                    return owned.back().get();
+                }
+                qnode *n = free.back();
+                free.pop_back();
+                return n;
+            };
+            void put(qnode *n) { free.push_back(n); };
+        };
+        static node_pool &pool() {
+            thread_local node_pool p;
+            return p;
+        };
+
+        alignas(64) std::atomic<qnode *> tail{nullptr};
+        // written by the holder only
+        qnode *holder = nullptr;
+
+        template<typename Pred>
+        static void spin_until(Pred done) {
+            for (int rounds = 0; !done(); rounds++) {
+                if (!spinning_useful() || rounds >= yield_after) {
+                    std::this_thread::yield();
+                } else {
+                    cpu_relax();
+                }
+            }
+        };
+
+    public:
+        mcs_lock() = default;
+        mcs_lock(const mcs_lock &) = delete;
+        mcs_lock &operator=(const mcs_lock &) = delete;
+
+        void lock() {
+            qnode *me = pool().get();
+            me->next.store(nullptr, std::memory_order_relaxed);
+            me->waiting.store(true, std::memory_order_relaxed);
+            qnode *pred = tail.exchange(me, std::memory_order_acq_rel);
+            if (pred) {
+                pred->next.store(me, std::memory_order_release);
+                spin_until([me] { return !me->waiting.load(std::memory_order_acquire); });
+            }
+            holder = me;
+        };
+        bool try_lock() {
+            qnode *me = pool().get();
+            me->next.store(nullptr, std::memory_order_relaxed);
+            qnode *expected = nullptr;
+            if (!tail.compare_exchange_strong(expected, me, std::memory_order_acquire,
+                                              std::memory_order_relaxed)) {
+                pool().put(me);
+                return false;
+            }
+            holder = me;
+            return true;
+        };
+        void unlock() {
+            qnode *me = holder;
+            qnode *succ = me->next.load(std::memory_order_acquire);
+            if (!succ) {
+                qnode *expected = me;
+                if (tail.compare_exchange_strong(expected, nullptr, std::memory_order_release,
+                                                 std::memory_order_relaxed)) {
+                    pool().put(me);
+                    return;
+                }
+                // a successor swapped itself in but has not linked yet
+                spin_until([&] {
+                    return (succ = me->next.load(std::memory_order_acquire)) != nullptr;
+                });
+            }
+            succ->waiting.store(false, std::memory_order_release);
+            pool().put(me);
+        };
+};
+
+// lets an exclusive-only lock stand in where SharedLockable is required;
+// readers simply take it exclusively
+template<typename Lock>
+class shared_as_exclusive : public Lock {
+    public:
+        void lock_shared() { this->lock(); };
+        bool try_lock_shared() { return this->try_lock(); };
+        void unlock_shared() { this->unlock(); };
+};
+#endif // __FAST_LOCKS_H__
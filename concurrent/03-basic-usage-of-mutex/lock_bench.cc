@@ -0,0 +1,129 @@
+#include "fast_locks.h"
+#include "threadsafe-queue.h"
+#include "threadsafe_stack.h"
+#include "unordered_map.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+// Each lock type under the same short critical sections: a bare counter
+// increment, push/pop on threadsafe_stack and ThreadsafeQueue, and a 90%
+// read mix on an 8-stripe ConcurrentHashMap. Reported in ops/s.
+
+constexpr auto run_for = std::chrono::milliseconds(200);
+
+template<typename Work>
+double run(unsigned threads, Work &&work) {
+    std::atomic<bool> stop{false};
+    std::atomic<unsigned long> total{0};
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            unsigned long ops = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 64; i++) {
+                    work(t, ops++);
+                }
+            }
+            total += ops;
+        });
+    }
+    std::this_thread::sleep_for(run_for);
+    stop = true;
+    for (auto &w : workers) {
+        w.join();
+    }
+    return total / std::chrono::duration<double>(run_for).count();
+}
+
+template<typename Lock>
+double counter(unsigned threads) {
+    Lock m_;
+    unsigned long count = 0;
+    std::atomic<unsigned long> ops{0};
+    double rate = run(threads, [&](unsigned, unsigned long) {
+        std::lock_guard<Lock> guard(m_);
+        count++;
+        ops.fetch_add(1, std::memory_order_relaxed);
+    });
+    assert(count == ops);
+    return rate;
+}
+
+template<typename Lock>
+double stack(unsigned threads) {
+    threadsafe_stack<int, Lock> s;
+    s.push(0);
+    return run(threads, [&](unsigned, unsigned long op) {
+        int v;
+        s.push(static_cast<int>(op));
+        s.pop(&v);
+    });
+}
+
+template<typename Lock>
+double queue(unsigned threads) {
+    ThreadsafeQueue<int, Lock> q;
+    return run(threads, [&](unsigned, unsigned long op) {
+        int v;
+        q.push(static_cast<int>(op));
+        q.try_pop(v);
+    });
+}
+
+template<typename SharedLock>
+double map(unsigned threads) {
+    ConcurrentHashMap<int, int, std::hash<int>, SharedLock> m(64, lock_stripes{8});
+    const int keys = 1 << 14;
+    for (int i = 0; i < keys; i++) {
+        m.set(i, i);
+    }
+    return run(threads, [&](unsigned t, unsigned long op) {
+        int k = static_cast<int>((op * 2654435761u + t * 40503u) & (keys - 1));
+        if (op % 10 == 0) {
+            m.set(k, k);
+        } else {
+            m.visit(k, [](const int &) {});
+        }
+    });
+}
+
+template<template<typename> class Bench>
+void table(const char *title, unsigned max_threads) {
+    std::printf("%s\n%8s %12s %12s %12s %12s\n", title, "threads", "std::mutex", "futex",
+                "ticket", "mcs");
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        std::printf("%8u %12.3e %12.3e %12.3e %12.3e\n", threads,
+                    Bench<std::mutex>::run(threads), Bench<futex_mutex>::run(threads),
+                    Bench<ticket_lock>::run(threads), Bench<mcs_lock>::run(threads));
+    }
+}
+
+template<typename L> struct CounterBench { static double run(unsigned n) { return counter<L>(n); } };
+template<typename L> struct StackBench { static double run(unsigned n) { return stack<L>(n); } };
+template<typename L> struct QueueBench { static double run(unsigned n) { return queue<L>(n); } };
+template<typename L> struct MapBench {
+    static double run(unsigned n) {
+        if constexpr (std::is_same_v<L, std::mutex>) {
+            return map<std::shared_mutex>(n);
+        } else {
+            return map<shared_as_exclusive<L>>(n);
+        }
+    }
+};
+
+int main(int argc, char *argv[]) {
+    unsigned max_threads = std::max(1u, argc > 1 ? std::atoi(argv[1]) : 2 * std::thread::hardware_concurrency());
+    table<CounterBench>("counter increment", max_threads);
+    table<StackBench>("threadsafe_stack push+pop", max_threads);
+    table<QueueBench>("ThreadsafeQueue push+try_pop", max_threads);
+    table<MapBench>("ConcurrentHashMap 90% visit (std::mutex column is std::shared_mutex)", max_threads);
+    return 0;
+}
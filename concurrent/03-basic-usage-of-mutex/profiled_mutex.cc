@@ -0,0 +1,129 @@
+#include "profiled_mutex.h"
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+std::uint64_t lock_report::percentile(const lock_histogram::counts_t &h, double q) {
+    std::uint64_t total = 0;
+    for (auto c : h) {
+        total += c;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    const auto rank = static_cast<std::uint64_t>(q * (total - 1));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < h.size(); i++) {
+        seen += h[i];
+        if (seen > rank) {
+            return std::uint64_t(1) << (i + 1);
+        }
+    }
+    return std::uint64_t(1) << h.size();
+};
+
+// This thread's block for each site, indexed by site id. Sites are never
+// destroyed, so the destructor can still hand the blocks back at exit.
+struct thread_blocks {
+    std::vector<std::pair<lock_site *, lock_site::thread_stats *>> by_site;
+    ~thread_blocks() {
+        for (auto &[site, stats] : by_site) {
+            if (stats) {
+                site->release(stats);
+            }
+        }
+    };
+};
+
+lock_site::thread_stats &lock_site::local() {
+    thread_local thread_blocks cache;
+    if (id >= cache.by_site.size()) {
+        cache.by_site.resize(id + 1, {nullptr, nullptr});
+    }
+    auto &entry = cache.by_site[id];
+    if (!entry.second) {
+        std::lock_guard<std::mutex> guard(m_);
+        if (!idle.empty()) {
+            // m_ orders the previous owner's last writes before ours
+            entry.second = idle.back();
+            idle.pop_back();
+        } else {
+            shards.push_back(std::make_unique<thread_stats>());
+            entry.second = shards.back().get();
+        }
+        entry.first = this;
+    }
+    return *entry.second;
+};
+
+void lock_site::release(thread_stats *stats) {
+    std::lock_guard<std::mutex> guard(m_);
+    idle.push_back(stats);
+};
+
+lock_report lock_site::report() const {
+    lock_report r;
+    r.site = name;
+    std::lock_guard<std::mutex> guard(m_);
+    for (auto &s : shards) {
+        r.acquisitions += s->acquisitions.load(std::memory_order_relaxed);
+        r.contended += s->contended.load(std::memory_order_relaxed);
+        s->wait.add_to(r.wait);
+        s->hold.add_to(r.hold);
+    }
+    return r;
+};
+
+lock_registry &lock_registry::instance() {
+    static lock_registry *registry = new lock_registry;
+    return *registry;
+};
+
+lock_site &lock_registry::site(const std::string &name) {
+    std::lock_guard<std::mutex> guard(m_);
+    auto it = by_name.find(name);
+    if (it != by_name.end()) {
+        return *it->second;
+    }
+    sites.push_back(std::make_unique<lock_site>(name, sites.size()));
+    by_name.emplace(name, sites.back().get());
+    return *sites.back();
+};
+
+std::vector<lock_report> lock_registry::reports() const {
+    std::vector<lock_site *> snapshot;
+    {
+        std::lock_guard<std::mutex> guard(m_);
+        for (auto &s : sites) {
+            snapshot.push_back(s.get());
+        }
+    }
+    std::vector<lock_report> out;
+    for (auto s : snapshot) {
+        out.push_back(s->report());
+    }
+    return out;
+};
+
+void lock_registry::dump(std::ostream &os) const {
+    auto all = reports();
+    std::sort(all.begin(), all.end(), [](const lock_report &a, const lock_report &b) {
+        return a.contended > b.contended;
+    });
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-28s %12s %12s %8s %10s %10s %10s %10s\n", "site",
+                  "acquired", "contended", "cont%", "wait p50", "wait p99", "hold p50", "hold p99");
+    os << line;
+    for (auto &r : all) {
+        std::snprintf(line, sizeof(line), "%-28s %12llu %12llu %7.2f%% %10llu %10llu %10llu %10llu\n",
+                      r.site.c_str(), static_cast<unsigned long long>(r.acquisitions),
+                      static_cast<unsigned long long>(r.contended),
+                      r.acquisitions ? 100.0 * r.contended / r.acquisitions : 0.0,
+                      static_cast<unsigned long long>(lock_report::percentile(r.wait, 0.5)),
+                      static_cast<unsigned long long>(lock_report::percentile(r.wait, 0.99)),
+                      static_cast<unsigned long long>(lock_report::percentile(r.hold, 0.5)),
+                      static_cast<unsigned long long>(lock_report::percentile(r.hold, 0.99)));
+        os << line;
+    }
+    os << "(times in ns, rounded up to a power of two)\n";
+};
@@ -0,0 +1,181 @@
+#ifndef __PROFILED_MUTEX_H__
+#define __PROFILED_MUTEX_H__
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// log2 histogram of nanoseconds: bucket i counts samples in [2^i, 2^(i+1)).
+// Only the owning thread records, so counting is a relaxed load and store.
+class lock_histogram {
+    public:
+        static constexpr std::size_t buckets = 40;
+        using counts_t = std::array<std::uint64_t, buckets>;
+
+        void record(std::uint64_t ns) {
+            std::size_t i = 0;
+            while (ns > 1 && i < buckets - 1) {
+                ns >>= 1;
+                i++;
+            }
+            counts[i].store(counts[i].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        };
+        void add_to(counts_t &out) const {
+            for (std::size_t i = 0; i < buckets; i++) {
+                out[i] += counts[i].load(std::memory_order_relaxed);
+            }
+        };
+
+    private:
+        std::array<std::atomic<std::uint64_t>, buckets> counts{};
+};
+
+struct lock_report {
+    std::string site;
+    std::uint64_t acquisitions = 0;
+    std::uint64_t contended = 0;
+    // wait covers contended acquisitions only; hold covers exclusive ones
+    lock_histogram::counts_t wait{};
+    lock_histogram::counts_t hold{};
+
+    // upper bound in ns of the bucket holding quantile q, 0 if empty
+    static std::uint64_t percentile(const lock_histogram::counts_t &h, double q);
+};
+
+// Every profiled_mutex constructed with the same site name reports into one
+// lock_site, e.g. all 64 stripes of a map. Each thread gets its own stats
+// block per site; blocks are only summed when a report is asked for. A
+// thread hands its blocks back when it exits and the next new thread takes
+// them over, so a site holds one block per concurrently live thread, not
+// one per thread ever started.
+class lock_site {
+    public:
+        struct alignas(64) thread_stats {
+            std::atomic<std::uint64_t> acquisitions{0};
+            std::atomic<std::uint64_t> contended{0};
+            lock_histogram wait;
+            lock_histogram hold;
+        };
+
+        lock_site(std::string name, std::size_t id) : name(std::move(name)), id(id) {};
+        lock_site(const lock_site &) = delete;
+        lock_site &operator=(const lock_site &) = delete;
+
+        thread_stats &local();
+        // called at thread exit with the block local() gave that thread
+        void release(thread_stats *stats);
+        lock_report report() const;
+        const std::string name;
+
+    private:
+        const std::size_t id;
+        mutable std::mutex m_;
+        std::vector<std::unique_ptr<thread_stats>> shards;
+        // blocks of exited threads, waiting for a new owner
+        std::vector<thread_stats *> idle;
+};
+
+class lock_registry {
+    public:
+        // never destroyed, so sites outlive every thread that records into them
+        static lock_registry &instance();
+        lock_site &site(const std::string &name);
+        std::vector<lock_report> reports() const;
+        // one line per site, hottest (most contended) first
+        void dump(std::ostream &os) const;
+
+    private:
+        lock_registry() = default;
+        mutable std::mutex m_;
+        std::vector<std::unique_ptr<lock_site>> sites;
+        std::unordered_map<std::string, lock_site *> by_name;
+};
+
+struct anonymous_lock_site {
+    static constexpr const char *name = "anonymous";
+};
+
+// Drop-in Lockable (and SharedLockable when Mutex is) that records
+// acquisitions, contended acquisitions, wait time and hold time into the
+// lock_site named by Site::name or by the constructor argument. An
+// uncontended lock costs one try_lock plus two clock reads.
+template<typename Mutex = std::mutex, typename Site = anonymous_lock_site>
+class profiled_mutex {
+    private:
+        using Clock = std::chrono::steady_clock;
+        lock_site &site;
+        Mutex m_;
+        // written by the exclusive owner only
+        Clock::time_point held_since;
+
+        template<typename TryLock, typename Lock>
+        Clock::time_point acquire(TryLock try_lock, Lock lock) {
+            auto &stats = site.local();
+            Clock::time_point now;
+            if (try_lock()) {
+                now = Clock::now();
+            } else {
+                const auto start = Clock::now();
+                lock();
+                now = Clock::now();
+                stats.contended.store(stats.contended.load(std::memory_order_relaxed) + 1,
+                                      std::memory_order_relaxed);
+                stats.wait.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count());
+            }
+            stats.acquisitions.store(stats.acquisitions.load(std::memory_order_relaxed) + 1,
+                                     std::memory_order_relaxed);
+            return now;
+        };
+
+    public:
+        // lets containers that hold several locks name each one after it
+        static constexpr const char *default_site = Site::name;
+
+        profiled_mutex() : profiled_mutex(Site::name) {};
+        explicit profiled_mutex(const char *site_name)
+            : site(lock_registry::instance().site(site_name)) {};
+        profiled_mutex(const profiled_mutex &) = delete;
+        profiled_mutex &operator=(const profiled_mutex &) = delete;
+
+        void lock() {
+            held_since = acquire([this] { return m_.try_lock(); }, [this] { m_.lock(); });
+        };
+        bool try_lock() {
+            if (!m_.try_lock()) {
+                return false;
+            }
+            auto &stats = site.local();
+            stats.acquisitions.store(stats.acquisitions.load(std::memory_order_relaxed) + 1,
+                                     std::memory_order_relaxed);
+            held_since = Clock::now();
+            return true;
+        };
+        void unlock() {
+            const auto held = Clock::now() - held_since;
+            m_.unlock();
+            site.local().hold.record(std::chrono::duration_cast<std::chrono::nanoseconds>(held).count());
+        };
+
+        // shared holds overlap, so only their waits are recorded
+        void lock_shared() {
+            acquire([this] { return m_.try_lock_shared(); }, [this] { m_.lock_shared(); });
+        };
+        bool try_lock_shared() {
+            if (!m_.try_lock_shared()) {
+                return false;
+            }
+            auto &stats = site.local();
+            stats.acquisitions.store(stats.acquisitions.load(std::memory_order_relaxed) + 1,
+                                     std::memory_order_relaxed);
+            return true;
+        };
+        void unlock_shared() { m_.unlock_shared(); };
+};
+#endif // __PROFILED_MUTEX_H__
@@ -0,0 +1,65 @@
+#include "profiled_mutex.h"
+#include "threadsafe-queue.h"
+#include "unordered_map.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+struct map_stripes {
+    static constexpr const char *name = "ConcurrentHashMap.stripe";
+};
+struct queue_locks {
+    static constexpr const char *name = "ThreadsafeQueue";
+};
+
+int main() {
+    profiled_mutex<> counter_m_("demo.counter");
+    long counter = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 10000; i++) {
+                std::lock_guard<profiled_mutex<>> guard(counter_m_);
+                counter++;
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    threads.clear();
+    assert(counter == 40000);
+    auto reports = lock_registry::instance().reports();
+    assert(reports.size() == 1 && reports[0].site == "demo.counter");
+    assert(reports[0].acquisitions == 40000 && reports[0].contended <= 40000);
+
+    // 8 stripes all report into one site
+    ConcurrentHashMap<int, int, std::hash<int>, profiled_mutex<std::shared_mutex, map_stripes>> map(64, lock_stripes{8});
+    ThreadsafeQueue<int, profiled_mutex<std::mutex, queue_locks>> queue;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 20000; i++) {
+                map.set(i, t);
+                map.get(i + 1);
+                queue.push(i);
+                queue.wait_and_pop_value();
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    assert(queue.empty() && map.size() == 20000);
+    // the queue's two locks each report under their own site
+    reports = lock_registry::instance().reports();
+    for (const char *role : {"ThreadsafeQueue.head", "ThreadsafeQueue.tail"}) {
+        assert(std::any_of(reports.begin(), reports.end(),
+                           [&](const lock_report &r) { return r.site == role && r.acquisitions > 0; }));
+    }
+    lock_registry::instance().dump(std::cout);
+    return 0;
+}
@@ -5,8 +5,11 @@
 #include <stack>
 #include <exception>
 #include <memory>
+#include "metrics.h"
 
-template<typename E>
+// Mutex is any Lockable, e.g. one of fast_locks.h. Metrics is a hook
+// policy from metrics.h; a pop from an empty stack counts as missed.
+template<typename E, typename Mutex = std::mutex, typename Metrics = no_metrics>
 class threadsafe_stack {
     struct empty_stack: std::exception {
         const char* what() const noexcept {return "stack empty";};
@@ -14,39 +17,46 @@ class threadsafe_stack {
 
     private:
         std::stack<E> stack;
-        mutable std::mutex m_;
+        mutable Mutex m_;
+        Metrics metrics_;
     public:
         threadsafe_stack() {};
         threadsafe_stack(const threadsafe_stack& other) {
-            std::lock_guard<std::mutex> guard(other.m_);
+            std::lock_guard<Mutex> guard(other.m_);
             stack = other.stack;  // move assign
         };
         threadsafe_stack& operator=(const threadsafe_stack&) = delete;
         void push(const E &element) {
-            std::lock_guard<std::mutex> guard(m_);
+            std::lock_guard<Mutex> guard(m_);
             stack.push(element);
+            metrics_.added();
         };
         std::shared_ptr<E> pop() {
-            std::lock_guard<std::mutex> guard(m_);
+            std::lock_guard<Mutex> guard(m_);
             if (stack.empty()) {
+                metrics_.missed();
                 throw empty_stack();
             }
             const std::shared_ptr<E> p {std::make_shared<E>(stack.top())};
             stack.pop();
+            metrics_.removed();
             return p;
         };
         void pop(E* ptr) {
-            std::lock_guard<std::mutex> guard(m_);
+            std::lock_guard<Mutex> guard(m_);
             if (stack.empty()) {
+                metrics_.missed();
                 throw empty_stack();
             }
-            ptr = &stack.top();
+            *ptr = std::move(stack.top());
             stack.pop();
+            metrics_.removed();
         };
         bool empty() const {
-            std::lock_guard<std::mutex> guard(m_);
+            std::lock_guard<Mutex> guard(m_);
             return stack.empty();
         };
+        const Metrics &metrics() const { return metrics_; };
 
 };
 #endif
@@ -0,0 +1,94 @@
+#include "flat-combining.h"
+#include <atomic>
+#include <cassert>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+template <typename Container> void run_push_pop() {
+    Container c;
+    const int threads = 8, per_thread = 20000;
+    std::atomic<long long> popped_sum{0};
+    std::atomic<int> popped{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            long long sum = 0;
+            int n = 0;
+            for (int i = 0; i < per_thread; i++) {
+                c.push(t * per_thread + i);
+                if (int x; i % 2 && c.try_pop(x)) {
+                    sum += x;
+                    n++;
+                }
+            }
+            for (int x; c.try_pop(x);) {
+                sum += x;
+                n++;
+            }
+            popped_sum += sum;
+            popped += n;
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    const long long total = static_cast<long long>(threads) * per_thread;
+    assert(popped == total && popped_sum == total * (total - 1) / 2);
+    assert(c.empty());
+}
+
+int main() {
+    FlatCombiningStack<std::unique_ptr<std::string>> stack;
+    stack.push(std::make_unique<std::string>("a"));
+    stack.emplace(new std::string("b"));
+    std::unique_ptr<std::string> s;
+    const bool popped_b = stack.try_pop(s);
+    assert(popped_b && *s == "b");
+    const bool popped_a = stack.try_pop(s);
+    assert(popped_a && *s == "a");
+    const bool popped_empty = stack.try_pop(s);
+    assert(!popped_empty && stack.empty());
+
+    FlatCombiningQueue<int> queue;
+    queue.push(1);
+    queue.push(2);
+    int v;
+    const bool popped_1 = queue.try_pop(v);
+    assert(popped_1 && v == 1);
+    const bool popped_2 = queue.try_pop(v);
+    assert(popped_2 && v == 2);
+    const bool popped_none = queue.try_pop(v);
+    assert(!popped_none);
+
+    run_push_pop<FlatCombiningStack<int>>();
+    run_push_pop<FlatCombiningQueue<int>>();
+
+    // any sequential container works, and exceptions reach the caller
+    FlatCombining<std::map<std::string, int>> counts;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++) {
+        workers.emplace_back([&] {
+            for (int i = 0; i < 1000; i++) {
+                counts.apply([&](std::map<std::string, int> &m) { m[std::to_string(i % 10)]++; });
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    const auto keys = counts.apply([](std::map<std::string, int> &m) { return m.size(); });
+    const auto sevens = counts.apply([](std::map<std::string, int> &m) { return m.at("7"); });
+    assert(keys == 10 && sevens == 400);
+    bool thrown = false;
+    try {
+        counts.apply([](std::map<std::string, int> &m) { return m.at("missing"); });
+    } catch (const std::out_of_range &) {
+        thrown = true;
+    }
+    assert(thrown);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "flat-combining.h"
+#include "threadsafe-deque.h"
+#include "threadsafe_stack.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Every thread alternates push and pop on one shared container, the worst
+// case for a single mutex. Each pair is one op; reported in ops/s.
+
+constexpr auto run_for = std::chrono::milliseconds(200);
+
+template <typename Work> double run(unsigned threads, Work &&work) {
+    std::atomic<bool> stop{false};
+    std::atomic<unsigned long> total{0};
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            unsigned long ops = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 64; i++) {
+                    work(ops++);
+                }
+            }
+            total += ops;
+        });
+    }
+    std::this_thread::sleep_for(run_for);
+    stop = true;
+    for (auto &w : workers) {
+        w.join();
+    }
+    return total / std::chrono::duration<double>(run_for).count();
+}
+
+double mutex_stack(unsigned threads) {
+    threadsafe_stack<int> s;
+    s.push(0);
+    return run(threads, [&](unsigned long op) {
+        int v;
+        s.push(static_cast<int>(op));
+        s.pop(&v);
+    });
+}
+
+double mutex_queue(unsigned threads) {
+    ThreadSafeQueue<int> q;
+    return run(threads, [&](unsigned long op) {
+        int v;
+        q.push(static_cast<int>(op));
+        q.try_pop(&v);
+    });
+}
+
+template <typename Container> double combined(unsigned threads) {
+    Container c;
+    return run(threads, [&](unsigned long op) {
+        int v;
+        c.push(static_cast<int>(op));
+        c.try_pop(v);
+    });
+}
+
+int main(int argc, char *argv[]) {
+    unsigned max_threads = argc > 1 ? std::atoi(argv[1]) : 64;
+    std::printf("%8s %14s %14s %14s %14s\n", "threads", "mutex stack", "fc stack", "mutex queue",
+                "fc queue");
+    for (unsigned threads = 2; threads <= std::max(2u, max_threads); threads *= 2) {
+        std::printf("%8u %14.3e %14.3e %14.3e %14.3e\n", threads, mutex_stack(threads),
+                    combined<FlatCombiningStack<int>>(threads), mutex_queue(threads),
+                    combined<FlatCombiningQueue<int>>(threads));
+    }
+    return 0;
+}
@@ -0,0 +1,237 @@
+#ifndef __FLAT_COMBINING_H__
+#define __FLAT_COMBINING_H__
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stack>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Flat combining (Hendler et al., 2010). Instead of every thread taking the
+// lock and pulling the container into its own cache, a thread publishes its
+// operation in its own record and spins on it. Whichever thread wins the
+// combiner lock applies every published operation in one pass, so the
+// container stays hot in one core's cache and the lock is handed over once
+// per batch rather than once per operation.
+template <typename Container> class FlatCombining {
+private:
+    static constexpr std::size_t cache_line = 64;
+    // threads whose id is past this take the combiner lock directly
+    static constexpr std::size_t max_records = 128;
+    static constexpr int combine_passes = 3;
+    static constexpr int spin_limit = 64;
+
+    struct Request {
+        std::exception_ptr error;
+        virtual void run(Container &c) = 0;
+    };
+    template <typename F, typename R> struct RequestImpl : Request {
+        F &f;
+        std::optional<R> result;
+        explicit RequestImpl(F &f) : f(f) {}
+        void run(Container &c) override { result.emplace(f(c)); }
+    };
+    template <typename F> struct RequestImpl<F, void> : Request {
+        F &f;
+        explicit RequestImpl(F &f) : f(f) {}
+        void run(Container &c) override { f(c); }
+    };
+
+    struct alignas(cache_line) Record {
+        std::atomic<Request *> pending{nullptr};
+    };
+
+    // small ids shared by every instance, recycled when a thread exits so
+    // the scanned prefix of records stays short
+    class ThreadIds {
+    private:
+        std::mutex m_;
+        std::vector<std::size_t> free_ids;
+        std::size_t next = 0;
+        struct Holder {
+            std::size_t id;
+            Holder() : id(instance().acquire()) {}
+            ~Holder() { instance().release(id); }
+        };
+        static ThreadIds &instance() {
+            static ThreadIds *ids = new ThreadIds;
+            return *ids;
+        }
+        std::size_t acquire() {
+            std::lock_guard<std::mutex> lk(m_);
+            if (free_ids.empty()) {
+                return next++;
+            }
+            std::size_t id = free_ids.back();
+            free_ids.pop_back();
+            return id;
+        }
+        void release(std::size_t id) {
+            std::lock_guard<std::mutex> lk(m_);
+            free_ids.push_back(id);
+        }
+
+    public:
+        static std::size_t local() {
+            thread_local Holder holder;
+            return holder.id;
+        }
+    };
+
+    alignas(cache_line) std::atomic<bool> locked{false};
+    std::atomic<std::size_t> active{0};
+    std::unique_ptr<Record[]> records;
+    alignas(cache_line) Container c;
+
+    bool try_lock() {
+        return !locked.load(std::memory_order_relaxed) &&
+               !locked.exchange(true, std::memory_order_acquire);
+    }
+    void unlock() { locked.store(false, std::memory_order_release); }
+
+    // caller holds the combiner lock; stops early once a pass finds nothing
+    void combine() {
+        for (int pass = 0; pass < combine_passes; pass++) {
+            bool found = false;
+            const std::size_t n = active.load(std::memory_order_acquire);
+            for (std::size_t i = 0; i < n; i++) {
+                Request *r = records[i].pending.load(std::memory_order_acquire);
+                if (!r) {
+                    continue;
+                }
+                try {
+                    r->run(c);
+                } catch (...) {
+                    r->error = std::current_exception();
+                }
+                records[i].pending.store(nullptr, std::memory_order_release);
+                found = true;
+            }
+            if (!found) {
+                break;
+            }
+        }
+    }
+
+    void publish(std::size_t id, Request &req) {
+        for (std::size_t n = active.load(std::memory_order_relaxed); n <= id;) {
+            active.compare_exchange_weak(n, id + 1, std::memory_order_release,
+                                         std::memory_order_relaxed);
+        }
+        Record &rec = records[id];
+        rec.pending.store(&req, std::memory_order_release);
+        for (int spins = 0; rec.pending.load(std::memory_order_acquire);) {
+            if (try_lock()) {
+                combine();
+                unlock();
+            } else if (++spins >= spin_limit) {
+                spins = 0;
+                std::this_thread::yield();
+            }
+        }
+        if (req.error) {
+            std::rethrow_exception(req.error);
+        }
+    }
+
+public:
+    template <typename... Args>
+    explicit FlatCombining(Args &&...args)
+        : records(new Record[max_records]), c(std::forward<Args>(args)...) {}
+    FlatCombining(const FlatCombining &other) = delete;
+    FlatCombining &operator=(const FlatCombining &other) = delete;
+
+    // Runs f(Container&) with exclusive access, possibly on another thread,
+    // and returns its result; an exception thrown by f is rethrown here.
+    // f must not call back into this object.
+    template <typename F> auto apply(F &&f) -> std::invoke_result_t<F &, Container &> {
+        using R = std::invoke_result_t<F &, Container &>;
+        const std::size_t id = ThreadIds::local();
+        if (id >= max_records) {
+            for (int spins = 0; !try_lock();) {
+                if (++spins >= spin_limit) {
+                    spins = 0;
+                    std::this_thread::yield();
+                }
+            }
+            struct Unlock {
+                FlatCombining *self;
+                ~Unlock() { self->unlock(); }
+            } unlock_on_exit{this};
+            combine();
+            return f(c);
+        }
+        RequestImpl<std::remove_reference_t<F>, R> req(f);
+        publish(id, req);
+        if constexpr (!std::is_void_v<R>) {
+            return std::move(*req.result);
+        }
+    }
+};
+
+// threadsafe_stack and ThreadSafeQueue counterparts run through one combiner
+template <typename E> class FlatCombiningStack {
+private:
+    FlatCombining<std::stack<E>> fc;
+
+public:
+    void push(const E &element) {
+        fc.apply([&](std::stack<E> &s) { s.push(element); });
+    }
+    void push(E &&element) {
+        fc.apply([&](std::stack<E> &s) { s.push(std::move(element)); });
+    }
+    template <typename... Args> void emplace(Args &&...args) {
+        fc.apply([&](std::stack<E> &s) { s.emplace(std::forward<Args>(args)...); });
+    }
+    bool try_pop(E &out) {
+        return fc.apply([&](std::stack<E> &s) {
+            if (s.empty()) {
+                return false;
+            }
+            out = std::move(s.top());
+            s.pop();
+            return true;
+        });
+    }
+    bool empty() {
+        return fc.apply([](std::stack<E> &s) { return s.empty(); });
+    }
+};
+
+template <typename E> class FlatCombiningQueue {
+private:
+    FlatCombining<std::queue<E>> fc;
+
+public:
+    void push(const E &element) {
+        fc.apply([&](std::queue<E> &q) { q.push(element); });
+    }
+    void push(E &&element) {
+        fc.apply([&](std::queue<E> &q) { q.push(std::move(element)); });
+    }
+    template <typename... Args> void emplace(Args &&...args) {
+        fc.apply([&](std::queue<E> &q) { q.emplace(std::forward<Args>(args)...); });
+    }
+    bool try_pop(E &out) {
+        return fc.apply([&](std::queue<E> &q) {
+            if (q.empty()) {
+                return false;
+            }
+            out = std::move(q.front());
+            q.pop();
+            return true;
+        });
+    }
+    bool empty() {
+        return fc.apply([](std::queue<E> &q) { return q.empty(); });
+    }
+};
+
+#endif // __FLAT_COMBINING_H__
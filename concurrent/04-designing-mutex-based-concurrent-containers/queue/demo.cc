@@ -1,4 +1,60 @@
+#include "mpmc-ring-queue.h"
+#include "threadsafe-queue.h"
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iterator>
+
+template <typename Queue> void run_mpmc(Queue &q, int producers, int consumers, long per_producer) {
+    std::atomic<long> sum{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; ++i) {
+        threads.emplace_back([&] {
+            for (long n = 1; n <= per_producer; ++n) {
+                q.push(n);
+            }
+        });
+    }
+    for (int i = 0; i < consumers; ++i) {
+        threads.emplace_back([&] {
+            for (long n = 0; n < per_producer * producers / consumers; ++n) {
+                sum += *q.wait_and_pop();
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    assert(q.empty());
+    assert(sum == producers * per_producer * (per_producer + 1) / 2);
+}
+
 int main() {
+    MpmcRingQueue<long> ring(256);
+    run_mpmc(ring, 4, 4, 100000);
+
+    ThreadsafeQueue<long> list;
+    run_mpmc(list, 4, 4, 100000);
+
+    ThreadsafeQueue<std::string> messages;
+    messages.emplace(64, 'x');
+    messages.push(std::string("hello"));
+    std::string s;
+    const bool popped = messages.try_pop(s);
+    assert(popped && s.size() == 64);
+    const auto hello = messages.wait_and_pop_value();
+    assert(hello == "hello");
+    const bool popped_empty = messages.try_pop(s);
+    const auto none = messages.try_pop();
+    assert(!popped_empty && none == nullptr);
 
+    std::vector<std::string> batch(200, "msg");
+    messages.push_bulk(batch.begin(), batch.end());
+    std::vector<std::string> drained;
+    const auto first_batch = messages.try_pop_bulk(std::back_inserter(drained), 64);
+    const auto rest = messages.wait_and_pop_bulk(std::back_inserter(drained), 256);
+    assert(first_batch == 64 && rest == 136);
+    assert(drained.size() == 200 && messages.empty());
     return 0;
 }
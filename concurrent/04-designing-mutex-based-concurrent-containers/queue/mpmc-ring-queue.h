@@ -0,0 +1,198 @@
+#ifndef __MPMC_RING_QUEUE_H__
+#define __MPMC_RING_QUEUE_H__
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Bounded lock-free MPMC queue (Vyukov). Every cell carries a sequence
+// number: seq == pos means the cell is free for the producer at pos,
+// seq == pos + 1 means it holds the value for the consumer at pos.
+// Blocking push/pop spin briefly and then park on an atomic wait.
+template <typename T> class MpmcRingQueue {
+private:
+    static constexpr std::size_t cache_line = 64;
+    static constexpr int spin_limit = 128;
+
+    struct Cell {
+        std::atomic<std::size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+        T *ptr() { return std::launder(reinterpret_cast<T *>(storage)); }
+    };
+
+    const std::size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    alignas(cache_line) std::atomic<std::size_t> enqueue_pos{0};
+    alignas(cache_line) std::atomic<std::size_t> dequeue_pos{0};
+    alignas(cache_line) std::atomic<std::uint32_t> not_empty{0};
+    std::atomic<std::uint32_t> pop_waiters{0};
+    alignas(cache_line) std::atomic<std::uint32_t> not_full{0};
+    std::atomic<std::uint32_t> push_waiters{0};
+
+    static std::size_t round_up(std::size_t n) {
+        std::size_t cap = 2;
+        while (cap < n) {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    static void wake(std::atomic<std::uint32_t> &signal, std::atomic<std::uint32_t> &waiters) {
+        // pairs with the fence in park(): either the waiter sees our
+        // update or we see the waiter
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) != 0) {
+            signal.fetch_add(1, std::memory_order_release);
+            signal.notify_one();
+        }
+    }
+
+    template <typename Attempt>
+    static void park(Attempt &&attempt, std::atomic<std::uint32_t> &signal,
+                     std::atomic<std::uint32_t> &waiters) {
+        for (int i = 0; i < spin_limit; ++i) {
+            if (attempt()) {
+                return;
+            }
+        }
+        for (;;) {
+            waiters.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto seen = signal.load(std::memory_order_acquire);
+            if (attempt()) {
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            signal.wait(seen, std::memory_order_acquire);
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename... Args> bool try_enqueue(Args &&...args) {
+        Cell *cell;
+        std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells[pos & mask];
+            std::size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        ::new (cell->storage) T(std::forward<Args>(args)...);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        wake(not_empty, pop_waiters);
+        return true;
+    }
+
+    // hands the stored value to f as an rvalue; the slot is released even if f throws
+    template <typename F> bool try_dequeue(F &&f) {
+        Cell *cell;
+        std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells[pos & mask];
+            std::size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        struct Release {
+            MpmcRingQueue *q;
+            Cell *cell;
+            std::size_t next;
+            ~Release() {
+                cell->ptr()->~T();
+                cell->seq.store(next, std::memory_order_release);
+                wake(q->not_full, q->push_waiters);
+            }
+        } release{this, cell, pos + mask + 1};
+        f(std::move(*cell->ptr()));
+        return true;
+    }
+
+    // construct the value before claiming a slot unless that cannot throw,
+    // so a throwing constructor never leaves a claimed but empty cell
+    template <typename... Args> bool try_emplace_impl(Args &&...args) {
+        if constexpr (std::is_nothrow_constructible_v<T, Args &&...>) {
+            return try_enqueue(std::forward<Args>(args)...);
+        } else {
+            T value(std::forward<Args>(args)...);
+            return try_enqueue(std::move(value));
+        }
+    }
+
+public:
+    static_assert(std::is_nothrow_move_constructible_v<T>,
+                  "MpmcRingQueue requires a nothrow move constructor");
+
+    explicit MpmcRingQueue(std::size_t capacity = 1024)
+        : mask(round_up(capacity) - 1), cells(new Cell[mask + 1]) {
+        for (std::size_t i = 0; i <= mask; ++i) {
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+    MpmcRingQueue(const MpmcRingQueue &other) = delete;
+    MpmcRingQueue &operator=(const MpmcRingQueue &other) = delete;
+    ~MpmcRingQueue() {
+        while (try_dequeue([](T &&) {})) {
+        }
+    }
+
+    bool try_push(const T &data) { return try_emplace_impl(data); }
+    bool try_push(T &&data) { return try_emplace_impl(std::move(data)); }
+    template <typename... Args> bool try_emplace(Args &&...args) {
+        return try_emplace_impl(std::forward<Args>(args)...);
+    }
+
+    // blocks while the queue is full
+    void push(const T &data) {
+        T value(data);
+        push(std::move(value));
+    }
+    void push(T &&data) {
+        park([&] { return try_enqueue(std::move(data)); }, not_full, push_waiters);
+    }
+
+    std::shared_ptr<T> try_pop() {
+        std::shared_ptr<T> p;
+        try_dequeue([&](T &&v) { p = std::make_shared<T>(std::move(v)); });
+        return p;
+    }
+    bool try_pop(T &value) {
+        return try_dequeue([&](T &&v) { value = std::move(v); });
+    }
+    std::shared_ptr<T> wait_and_pop() {
+        std::shared_ptr<T> p;
+        park([&] { return try_dequeue([&](T &&v) { p = std::make_shared<T>(std::move(v)); }); },
+             not_empty, pop_waiters);
+        return p;
+    }
+    void wait_and_pop(T &value) {
+        park([&] { return try_dequeue([&](T &&v) { value = std::move(v); }); }, not_empty,
+             pop_waiters);
+    }
+
+    bool empty() const {
+        std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        return cells[pos & mask].seq.load(std::memory_order_acquire) != pos + 1;
+    }
+    std::size_t capacity() const { return mask + 1; }
+};
+
+#endif // __MPMC_RING_QUEUE_H__
@@ -1,33 +1,82 @@
 #ifndef __THREADSAFEQUEUE_H__
 #define __THREADSAFEQUEUE_H__
 #include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
 
-template <typename T> class ThreadsafeQueue {
+#include "metrics.h"
+
+// Mutex is any Lockable; anything other than std::mutex waits through
+// condition_variable_any. A Mutex constructible from a site name, like
+// profiled_mutex, gets a separate site per lock ("<site>.head" and
+// ".tail"), so its reports tell the two apart. Metrics is a hook policy
+// from metrics.h: pushes count as added, pops as removed, a try_pop on an
+// empty queue as missed, and a blocking pop's time asleep as waited.
+template <typename T, typename Mutex = std::mutex, typename Metrics = no_metrics> class ThreadsafeQueue {
 private:
+    // head is always a spent dummy; the front value lives in head->next.
+    // Producers construct the value in a node before taking tail_m_.
     struct Node {
-        std::shared_ptr<T> data;
+        std::optional<T> data;
         std::unique_ptr<Node> next;
-        Node() = default;
-        Node(const T &data) : data(std::make_shared<T>(data)), next(nullptr) {}
-        ~Node() = default;
     };
-    mutable std::mutex head_m_;
-    mutable std::mutex tail_m_;
+    using CondVar = std::conditional_t<std::is_same_v<Mutex, std::mutex>, std::condition_variable,
+                                       std::condition_variable_any>;
+    static constexpr bool named_locks = std::is_constructible_v<Mutex, const char *>;
+    // a Mutex that ignores names is simply default-constructed
+    struct Lock : Mutex {
+        Lock(const char *site, const char *role) : Lock(site, role, std::bool_constant<named_locks>{}) {}
+
+    private:
+        Lock(const char *site, const char *role, std::true_type) : Mutex((std::string(site) + role).c_str()) {}
+        Lock(const char *, const char *, std::false_type) {}
+    };
+    static const char *default_lock_site() {
+        if constexpr (named_locks) {
+            return Mutex::default_site;
+        } else {
+            return "ThreadsafeQueue";
+        }
+    }
+    static constexpr std::size_t cache_line = 64;
+    // Spent nodes wait in a bounded ring for the next push, so producers
+    // and consumers share no lock over them. Slots follow MpmcRingQueue's
+    // sequence scheme without the blocking; a node that finds the ring
+    // full is deleted, which caps the spares at free_capacity.
+    static constexpr std::size_t free_capacity = 256;
+    struct FreeSlot {
+        std::atomic<std::size_t> seq;
+        Node *node;
+    };
+
+    mutable Lock head_m_;
+    mutable Lock tail_m_;
     std::unique_ptr<Node> head;
     Node *tail;
-    std::condition_variable not_empty;
+    std::unique_ptr<FreeSlot[]> free_slots;
+    alignas(cache_line) std::atomic<std::size_t> free_put{0};
+    alignas(cache_line) std::atomic<std::size_t> free_take{0};
+    CondVar not_empty;
+    std::atomic<int> waiters{0};
+    Metrics metrics_;
 
     Node *back() {
-        std::lock_guard<std::mutex> lk(tail_m_);
+        std::lock_guard<Mutex> lk(tail_m_);
         return tail;
     };
 
     std::unique_ptr<Node> pop_front() {
         std::unique_ptr<Node> p = std::move(head);
-        head = std::move(head->next);
+        head = std::move(p->next);
         return p;
     };
 
@@ -38,42 +87,283 @@ private:
         return pop_front();
     }
 
-    std::unique_lock<std::mutex> acquire_front() {
-        std::unique_lock<std::mutex> head_lk(head_m_);
-        not_empty.wait(head_lk, [this] { return head.get() == back(); });
-        return head_lk; // std::move(head_lk);
+    // Detaches up to max_n values while head_m_ is held. All but the last
+    // value stay in the detached chain and are read after the lock is
+    // dropped; the last one sits in the new dummy head, so it is moved out
+    // into last here.
+    std::size_t pop_front_bulk(std::size_t max_n, std::unique_ptr<Node> &chain,
+                               std::optional<T> &last) {
+        Node *const end = back();
+        Node *prev = nullptr;
+        Node *cur = head.get();
+        std::size_t n = 0;
+        while (n < max_n && cur != end) {
+            prev = cur;
+            cur = cur->next.get();
+            ++n;
+        }
+        if (n == 0) {
+            return 0;
+        }
+        chain = std::move(head);
+        head = std::move(prev->next);
+        last.emplace(std::move(*head->data));
+        return n;
+    }
+
+    template <typename OutputIt>
+    OutputIt drain_chain(std::unique_ptr<Node> chain, std::optional<T> &last, OutputIt out) {
+        for (Node *p = chain->next.get(); p; p = p->next.get()) {
+            *out++ = std::move(*p->data);
+        }
+        *out++ = std::move(*last);
+        recycle_chain(std::move(chain));
+        return out;
+    }
+
+    std::unique_lock<Mutex> acquire_front() {
+        std::unique_lock<Mutex> head_lk(head_m_);
+        if (head.get() == back()) {
+            const auto t = metrics_.start();
+            waiters.fetch_add(1, std::memory_order_seq_cst);
+            not_empty.wait(head_lk, [this] { return head.get() != back(); });
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+            metrics_.waited(t);
+        }
+        return head_lk;
+    }
+
+    // Producers never take head_m_, so a consumer may test the predicate
+    // and then miss a notify sent before it blocks. A registered waiter
+    // holds head_m_ until it is inside wait(), so cycling head_m_ closes
+    // that window; without waiters the notify is skipped entirely.
+    void notify(bool all = false) {
+        if (waiters.load(std::memory_order_seq_cst) != 0) {
+            { std::lock_guard<Mutex> lk(head_m_); }
+            if (all) {
+                not_empty.notify_all();
+            } else {
+                not_empty.notify_one();
+            }
+        }
+    }
+
+    // false when the ring is full
+    bool put_free(Node *p) {
+        std::size_t pos = free_put.load(std::memory_order_relaxed);
+        for (;;) {
+            FreeSlot &slot = free_slots[pos & (free_capacity - 1)];
+            const std::size_t seq = slot.seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (free_put.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.node = p;
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = free_put.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // nullptr when the ring is empty
+    Node *take_free() {
+        std::size_t pos = free_take.load(std::memory_order_relaxed);
+        for (;;) {
+            FreeSlot &slot = free_slots[pos & (free_capacity - 1)];
+            const std::size_t seq = slot.seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (free_take.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    Node *const p = slot.node;
+                    slot.seq.store(pos + free_capacity, std::memory_order_release);
+                    return p;
+                }
+            } else if (diff < 0) {
+                return nullptr;
+            } else {
+                pos = free_take.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::unique_ptr<Node> acquire_node() {
+        if (Node *p = take_free()) {
+            return std::unique_ptr<Node>(p);
+        }
+        return std::make_unique<Node>();
+    }
+
+    void recycle(std::unique_ptr<Node> p) {
+        p->data.reset();
+        p->next.reset();
+        if (put_free(p.get())) {
+            p.release();
+        }
+    }
+
+    void recycle_chain(std::unique_ptr<Node> chain) {
+        while (chain) {
+            std::unique_ptr<Node> next = std::move(chain->next);
+            recycle(std::move(chain));
+            chain = std::move(next);
+        }
+    }
+
+    static void destroy_chain(std::unique_ptr<Node> p) {
+        while (p) {
+            p = std::move(p->next);
+        }
     }
 
 public:
-    ThreadsafeQueue() : head(new Node), tail(head.get()) {}
+    ThreadsafeQueue() : ThreadsafeQueue(default_lock_site()) {}
+    // lock_site prefixes the locks' site names; unused unless Mutex takes one
+    explicit ThreadsafeQueue(const char *lock_site)
+        : head_m_(lock_site, ".head"), tail_m_(lock_site, ".tail"), head(new Node), tail(head.get()),
+          free_slots(new FreeSlot[free_capacity]) {
+        for (std::size_t i = 0; i < free_capacity; i++) {
+            free_slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
     ThreadsafeQueue(const ThreadsafeQueue &other) = delete;
     ThreadsafeQueue &operator=(const ThreadsafeQueue &other) = delete;
+    ~ThreadsafeQueue() {
+        destroy_chain(std::move(head));
+        while (Node *p = take_free()) {
+            delete p;
+        }
+    }
+
     std::shared_ptr<T> try_pop() {
+        std::unique_ptr<Node> p;
+        std::optional<T> value;
+        {
+            std::lock_guard<Mutex> lk(head_m_);
+            p = try_pop_front();
+            if (!p) {
+                metrics_.missed();
+                return nullptr;
+            }
+            value.emplace(std::move(*head->data));
+        }
+        metrics_.removed();
+        recycle(std::move(p));
+        return std::make_shared<T>(std::move(*value));
+    };
+    bool try_pop(T &value) {
         std::unique_ptr<Node> p;
         {
-            std::lock_guard<std::mutex> lk(head_m_);
+            std::lock_guard<Mutex> lk(head_m_);
             p = try_pop_front();
+            if (!p) {
+                metrics_.missed();
+                return false;
+            }
+            value = std::move(*head->data);
         }
-        return p ? std::move(p->data) : nullptr;
+        metrics_.removed();
+        recycle(std::move(p));
+        return true;
     };
     std::shared_ptr<T> wait_and_pop() {
-        auto head_lk = acquire_front();
-        return std::move(pop_front()->data);
+        return std::make_shared<T>(wait_and_pop_value());
+    };
+    T wait_and_pop_value() {
+        std::unique_ptr<Node> p;
+        std::optional<T> value;
+        {
+            auto head_lk = acquire_front();
+            p = pop_front();
+            value.emplace(std::move(*head->data));
+        }
+        metrics_.removed();
+        recycle(std::move(p));
+        return std::move(*value);
     };
-    void push(const T &data) {
-        std::unique_ptr<Node> p(new Node(data));
+    template <typename... Args> void emplace(Args &&...args) {
+        std::unique_ptr<Node> p = acquire_node();
+        p->data.emplace(std::forward<Args>(args)...);
         {
-            std::lock_guard<std::mutex> lk(tail_m_);
-            tail->data = std::move(p->data);
+            std::lock_guard<Mutex> lk(tail_m_);
+            Node *const new_tail = p.get();
             tail->next = std::move(p);
-            tail = p.get();
+            tail = new_tail;
+        }
+        metrics_.added();
+        notify();
+    };
+    // builds the whole chain first, then links it with one tail_m_
+    // acquisition and a single wakeup
+    template <typename InputIt> void push_bulk(InputIt first, InputIt last) {
+        if (first == last) {
+            return;
+        }
+        std::unique_ptr<Node> chain;
+        Node *chain_tail = nullptr;
+        std::size_t n = 0;
+        try {
+            for (; first != last; ++first, ++n) {
+                std::unique_ptr<Node> p = acquire_node();
+                p->data.emplace(*first);
+                Node *const raw = p.get();
+                (chain_tail ? chain_tail->next : chain) = std::move(p);
+                chain_tail = raw;
+            }
+        } catch (...) {
+            recycle_chain(std::move(chain));
+            throw;
+        }
+        {
+            std::lock_guard<Mutex> lk(tail_m_);
+            tail->next = std::move(chain);
+            tail = chain_tail;
+        }
+        metrics_.added(n);
+        notify(n > 1);
+    };
+    template <typename OutputIt> std::size_t try_pop_bulk(OutputIt out, std::size_t max_n) {
+        std::unique_ptr<Node> chain;
+        std::optional<T> last;
+        std::size_t n;
+        {
+            std::lock_guard<Mutex> lk(head_m_);
+            n = pop_front_bulk(max_n, chain, last);
+        }
+        if (n != 0) {
+            metrics_.removed(n);
+            drain_chain(std::move(chain), last, out);
+        } else {
+            metrics_.missed();
+        }
+        return n;
+    };
+    // blocks until at least one value is available
+    template <typename OutputIt> std::size_t wait_and_pop_bulk(OutputIt out, std::size_t max_n) {
+        if (max_n == 0) {
+            return 0;
+        }
+        std::unique_ptr<Node> chain;
+        std::optional<T> last;
+        std::size_t n;
+        {
+            auto head_lk = acquire_front();
+            n = pop_front_bulk(max_n, chain, last);
         }
-        not_empty.notify_one();
+        metrics_.removed(n);
+        drain_chain(std::move(chain), last, out);
+        return n;
     };
+    void push(const T &data) { emplace(data); };
+    void push(T &&data) { emplace(std::move(data)); };
     bool empty() {
-        std::lock_guard<std::mutex> lk(head_m_);
+        std::lock_guard<Mutex> lk(head_m_);
         return head.get() == back();
     };
+    const Metrics &metrics() const { return metrics_; };
 };
 
 #endif // __THREADSAFEQUEUE_H__
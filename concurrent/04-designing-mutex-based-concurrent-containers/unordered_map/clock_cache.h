@@ -0,0 +1,306 @@
+#ifndef CLOCK_CACHE_H_
+#define CLOCK_CACHE_H_
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+#include "flat_table.h"
+#include "metrics.h"
+
+// Bounded counterpart of ConcurrentHashMap with the same get/set/remove
+// surface and the same sharding: a key hashes to one of up to Shards
+// shards, each with its own lock, flat index and share of the capacity.
+//
+// Eviction is CLOCK rather than LRU. A hit only sets the entry's referenced
+// bit, under the same shared lock a plain ConcurrentHashMap::get takes, so
+// readers never reorder a list. When an insert needs room, the shard's hand
+// sweeps its entries under the exclusive lock: referenced ones get their bit
+// cleared and a second chance, the first unreferenced or expired one goes.
+//
+// Capacity is a total weight. Every entry weighs 1 unless set is given a
+// weight, so with byte sizes as weights it bounds bytes instead of entries.
+// The shares add up to exactly the capacity, but each shard enforces only
+// its own: an entry heavier than its shard's share (capacity / shard_count(),
+// rounded up or down) is not cached at all. Caches of a few heavy entries
+// want a smaller Shards. With a nonzero ttl, entries older than it read as
+// misses and are the first to be reclaimed.
+template<typename K, typename V, typename Hash=std::hash<K>, std::size_t Shards=64,
+         typename SharedMutex=std::shared_mutex>
+class ConcurrentClockCache {
+    static_assert(Shards != 0 && (Shards & (Shards - 1)) == 0, "Shards must be a power of two");
+public:
+    using clock = std::chrono::steady_clock;
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        // dropped to make room, and dropped because their ttl ran out
+        std::uint64_t evictions = 0;
+        std::uint64_t expirations = 0;
+    };
+
+private:
+    static constexpr std::size_t cache_line = 64;
+    struct Entry {
+        std::optional<std::pair<K, V>> kv;
+        std::size_t hash = 0;
+        std::size_t weight = 0;
+        clock::time_point expires;
+        // set by hits under the shared lock, cleared by the hand
+        std::atomic<bool> referenced{false};
+    };
+    class alignas(cache_line) Shard {
+    private:
+        // entries live in a deque so their addresses survive growth; the
+        // index maps a key to its position, and freed positions are reused
+        std::deque<Entry> entries;
+        std::vector<std::uint32_t> free;
+        IncrementalTable<K, std::uint32_t> index;
+        std::size_t hand = 0;
+        std::size_t weight = 0;
+        std::atomic<std::size_t> count{0};
+        std::atomic<std::size_t> weight_now{0};
+        std::atomic<std::uint64_t> evictions{0};
+        std::atomic<std::uint64_t> expirations{0};
+
+        bool expired(const Entry &e, clock::time_point now) const {
+            return e.expires <= now;
+        };
+        // looks k up and marks it referenced; null on a miss or an expired hit
+        const Entry *hit(const K &k, std::size_t h) {
+            auto s = index.find(k, h);
+            Entry *e = s ? &entries[s->value] : nullptr;
+            if (e && ttl != clock::duration::zero() && expired(*e, clock::now())) {
+                e = nullptr;
+            }
+            if (!e) {
+                return nullptr;
+            }
+            // the load keeps hot entries' lines shared instead of rewritten
+            if (!e->referenced.load(std::memory_order_relaxed)) {
+                e->referenced.store(true, std::memory_order_relaxed);
+            }
+            return e;
+        };
+        void drop(std::uint32_t i) {
+            Entry &e = entries[i];
+            index.erase(index.find(e.kv->first, e.hash));
+            weight -= e.weight;
+            e.kv.reset();
+            free.push_back(i);
+        };
+        // sweeps until need more weight fits, skipping keep; every entry is
+        // passed at most twice, since the first pass clears all the bits
+        void make_room(std::size_t need, std::size_t keep, clock::time_point now) {
+            while (weight + need > capacity && index.size() > (keep < entries.size() ? 1 : 0)) {
+                hand = hand + 1 < entries.size() ? hand + 1 : 0;
+                Entry &e = entries[hand];
+                if (!e.kv || hand == keep) {
+                    continue;
+                }
+                if (expired(e, now)) {
+                    expirations.fetch_add(1, std::memory_order_relaxed);
+                } else if (e.referenced.load(std::memory_order_relaxed)) {
+                    e.referenced.store(false, std::memory_order_relaxed);
+                    continue;
+                } else {
+                    evictions.fetch_add(1, std::memory_order_relaxed);
+                }
+                drop(static_cast<std::uint32_t>(hand));
+            }
+        };
+        clock::time_point deadline(clock::time_point now) const {
+            return ttl == clock::duration::zero() ? clock::time_point::max() : now + ttl;
+        };
+        void publish() {
+            count.store(index.size(), std::memory_order_relaxed);
+            weight_now.store(weight, std::memory_order_relaxed);
+        };
+
+    public:
+        mutable SharedMutex m_;
+        std::size_t capacity = 0;
+        clock::duration ttl{};
+
+        std::shared_ptr<V> get(const K &k, std::size_t h) {
+            std::shared_lock slock(m_);
+            const Entry *e = hit(k, h);
+            return e ? std::make_shared<V>(e->kv->second) : nullptr;
+        };
+        template<typename F>
+        bool visit(const K &k, std::size_t h, F &f) {
+            std::shared_lock slock(m_);
+            const Entry *e = hit(k, h);
+            if (!e) {
+                return false;
+            }
+            f(static_cast<const V &>(e->kv->second));
+            return true;
+        };
+        template<typename KK, typename VV>
+        void set(KK &&k, VV &&v, std::size_t h, std::size_t w) {
+            const auto now = clock::now();
+            std::unique_lock xlock(m_);
+            auto s = index.find(k, h);
+            if (w > capacity) {
+                if (s) {
+                    drop(s->value);
+                    publish();
+                }
+                return;
+            }
+            if (s) {
+                const std::uint32_t i = s->value;
+                Entry &e = entries[i];
+                e.kv->second = std::forward<VV>(v);
+                weight = weight - e.weight + w;
+                e.weight = w;
+                e.expires = deadline(now);
+                make_room(0, i, now);
+                publish();
+                return;
+            }
+            make_room(w, entries.size(), now);
+            std::uint32_t i;
+            if (!free.empty()) {
+                i = free.back();
+                free.pop_back();
+            } else {
+                i = static_cast<std::uint32_t>(entries.size());
+                entries.emplace_back();
+            }
+            Entry &e = entries[i];
+            e.kv.emplace(std::forward<KK>(k), std::forward<VV>(v));
+            e.hash = h;
+            e.weight = w;
+            e.expires = deadline(now);
+            e.referenced.store(false, std::memory_order_relaxed);
+            index.try_emplace(h, e.kv->first, i);
+            weight += w;
+            publish();
+        };
+        std::shared_ptr<V> remove(const K &k, std::size_t h) {
+            std::unique_lock xlock(m_);
+            auto s = index.find(k, h);
+            if (!s) {
+                return nullptr;
+            }
+            const std::uint32_t i = s->value;
+            auto p = std::make_shared<V>(std::move(entries[i].kv->second));
+            drop(i);
+            publish();
+            return p;
+        };
+        std::size_t size() const { return count.load(std::memory_order_relaxed); };
+        std::size_t total_weight() const { return weight_now.load(std::memory_order_relaxed); };
+        void add_stats(Stats &out) const {
+            out.evictions += evictions.load(std::memory_order_relaxed);
+            out.expirations += expirations.load(std::memory_order_relaxed);
+        };
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    std::size_t shard_mask = 0;
+    std::size_t total_capacity;
+    // bumped by every reader, so striped per thread rather than per shard
+    striped_counter hits;
+    striped_counter misses;
+    Hash hasher;
+    // same mixing and shard choice as ConcurrentHashMap
+    std::size_t hash(const K &k) const {
+        std::size_t h = hasher(k);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    };
+    Shard &get_shard(std::size_t h) const { return shards[(h >> 32) & shard_mask]; };
+    template<typename P>
+    P counted(P p) {
+        if (p) {
+            hits.add();
+        } else {
+            misses.add();
+        }
+        return p;
+    };
+
+public:
+    // Uses Shards shards, or fewer for a capacity under Shards so that every
+    // shard can hold at least one entry. The capacity is split as evenly as
+    // the shard count allows, and the shares add up to exactly capacity. A
+    // zero ttl never expires anything.
+    explicit ConcurrentClockCache(std::size_t capacity, clock::duration ttl = clock::duration::zero())
+        : total_capacity(capacity) {
+        while (shard_mask + 1 < Shards && (shard_mask + 1) * 2 <= capacity) {
+            shard_mask = shard_mask * 2 + 1;
+        }
+        const std::size_t n = shard_mask + 1;
+        shards.reset(new Shard[n]);
+        for (std::size_t i = 0; i < n; i++) {
+            shards[i].capacity = capacity / n + (i < capacity % n ? 1 : 0);
+            shards[i].ttl = ttl;
+        }
+    };
+    ConcurrentClockCache(const ConcurrentClockCache&) = delete;
+    ConcurrentClockCache& operator=(const ConcurrentClockCache&) = delete;
+
+    std::shared_ptr<V> get(const K &k) {
+        const auto h = hash(k);
+        return counted(get_shard(h).get(k, h));
+    };
+    // f(const V&) runs under the shard's shared lock; false on a miss
+    template<typename F>
+    bool visit(const K &k, F &&f) {
+        const auto h = hash(k);
+        return counted(get_shard(h).visit(k, h, f));
+    };
+    void set(const K &k, const V &v, std::size_t weight = 1) {
+        const auto h = hash(k);
+        get_shard(h).set(k, v, h, weight);
+    };
+    void set(K &&k, V &&v, std::size_t weight = 1) {
+        const auto h = hash(k);
+        get_shard(h).set(std::move(k), std::move(v), h, weight);
+    };
+    std::shared_ptr<V> remove(const K &k) {
+        const auto h = hash(k);
+        return get_shard(h).remove(k, h);
+    };
+
+    // the sums below take no locks, so concurrent writes may or may not be
+    // reflected
+    std::size_t size() const {
+        std::size_t n = 0;
+        for (std::size_t i = 0; i <= shard_mask; i++) {
+            n += shards[i].size();
+        }
+        return n;
+    };
+    std::size_t weight() const {
+        std::size_t n = 0;
+        for (std::size_t i = 0; i <= shard_mask; i++) {
+            n += shards[i].total_weight();
+        }
+        return n;
+    };
+    std::size_t capacity() const { return total_capacity; };
+    std::size_t shard_count() const { return shard_mask + 1; };
+    Stats stats() const {
+        Stats s;
+        s.hits = static_cast<std::uint64_t>(hits.value());
+        s.misses = static_cast<std::uint64_t>(misses.value());
+        for (std::size_t i = 0; i <= shard_mask; i++) {
+            shards[i].add_stats(s);
+        }
+        return s;
+    };
+};
+#endif // CLOCK_CACHE_H_
@@ -1,4 +1,199 @@
+#include "clock_cache.h"
+#include "rcu_hash_map.h"
+#include "unordered_map.h"
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+
 int main() {
+    ConcurrentHashMap<int, std::string> map;
+    const int threads = 4, per_thread = 50000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            for (int i = t; i < threads * per_thread; i += threads) {
+                map.set(i, std::to_string(i));
+            }
+            for (int i = t; i < threads * per_thread; i += 2 * threads) {
+                const auto removed = map.remove(i);
+                assert(removed && *removed == std::to_string(i));
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    for (int i = 0; i < threads * per_thread; i++) {
+        auto v = map.get(i);
+        if (i % (2 * threads) < threads) {
+            assert(v == nullptr);
+        } else {
+            assert(v && *v == std::to_string(i));
+        }
+    }
+    map.set(1, "one");
+    assert(*map.get(1) == "one");
+    assert(map.load_factor() > 0 && map.load_factor() <= 1);
+
+    ConcurrentHashMap<int, int> sized;
+    sized.reserve(100000);
+    const auto slots = sized.bucket_count();
+    for (int i = 0; i < 100000; i++) {
+        sized.set(i, i);
+    }
+    assert(sized.bucket_count() == slots);
+
+    ConcurrentHashMap<std::string, long> counters;
+    std::vector<std::thread> bumpers;
+    for (int t = 0; t < 4; t++) {
+        bumpers.emplace_back([&] {
+            for (int i = 0; i < 10000; i++) {
+                counters.upsert("hits", [] { return 1L; }, [](long &v) { v++; });
+            }
+        });
+    }
+    for (auto &b : bumpers) {
+        b.join();
+    }
+    assert(counters.visit("hits", [](const long &v) { assert(v == 40000); }));
+    const bool hits_emplaced = counters.try_emplace("hits", 0L);
+    const bool misses_emplaced = counters.try_emplace("misses", 5L);
+    assert(!hits_emplaced && misses_emplaced);
+    const bool doubled = counters.visit_mut("misses", [](long &v) { v *= 2; });
+    assert(doubled && *counters.get("misses") == 10);
+    const bool dropped = counters.compute_if_present("misses", [](long &v) { return --v > 100; });
+    const bool again = counters.compute_if_present("misses", [](long &) { return true; });
+    assert(dropped && !again && !counters.get("misses"));
+    std::string key = "moved";
+    counters.set(std::move(key), 7L);
+    assert(*counters.get("moved") == 7);
+
+    assert(sized.size() == 100000);
+    std::atomic<long> total{0};
+    sized.for_each_parallel([&](const int &, const int &v) { total += v; }, 4);
+    assert(total == 100000L * 99999 / 2);
+    auto copy = sized.snapshot(2);
+    assert(copy.size() == 100000);
+
+    ConcurrentHashMap<int, int> striped(16, lock_stripes{6});
+    assert(striped.stripe_count() == 8);
+    for (int i = 0; i < 1000; i++) {
+        striped.set(i, -i);
+    }
+    assert(striped.size() == 1000 && *striped.get(999) == -999);
+    // the single argument is still the bucket count, and every stripe
+    // guards at least one bucket
+    ConcurrentHashMap<int, int> small(4), capped(4, lock_stripes{64});
+    assert(small.stripe_count() == 4 && capped.stripe_count() == 4);
+
+    RcuHashMap<int, std::string> rcu(16, 4);
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        while (!done.load()) {
+            for (int i = 0; i < 1000; i++) {
+                auto v = rcu.get(i);
+                assert(!v || *v == std::to_string(i) || *v == "updated");
+            }
+        }
+    });
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 1000; i++) {
+            rcu.set(i, std::to_string(i));
+        }
+        for (int i = 0; i < 1000; i += 2) {
+            rcu.set(i, "updated");
+            const auto removed = rcu.remove(i);
+            assert(removed && *removed == "updated");
+        }
+    }
+    done = true;
+    reader.join();
+    assert(rcu.size() == 500 && rcu.bucket_count() >= 256);
+    assert(rcu.visit(1, [](const std::string &v) { assert(v == "1"); }));
+    assert(!rcu.get(0));
+
+    // writers keep going while the table grows under them
+    RcuHashMap<int, int> growing(16, 4);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; t++) {
+        writers.emplace_back([&, t] {
+            for (int i = t; i < 20000; i += 4) {
+                growing.set(i, i);
+                if (i % 3 == 0) {
+                    growing.remove(i);
+                }
+            }
+        });
+    }
+    for (auto &w : writers) {
+        w.join();
+    }
+    for (int i = 0; i < 20000; i++) {
+        auto v = growing.get(i);
+        assert(i % 3 == 0 ? !v : v && *v == i);
+    }
+
+    // one shard, so the hand's order is easy to follow
+    ConcurrentClockCache<int, std::string, std::hash<int>, 1> cache(3);
+    cache.set(1, "a");
+    cache.set(2, "b");
+    cache.set(3, "c");
+    // hits set the referenced bit, so they stay out of the asserts
+    const auto a = cache.get(1), c = cache.get(3);
+    assert(*a == "a" && *c == "c");
+    // 2 is the only entry without a second chance
+    cache.set(4, "d");
+    const auto b = cache.get(2);
+    assert(!b && cache.size() == 3);
+    auto stats = cache.stats();
+    assert(stats.hits == 2 && stats.misses == 1 && stats.evictions == 1);
+    // weights: 5 does not fit beside anything, 6 does not fit at all
+    cache.set(5, "e", 3);
+    const auto e = cache.get(5);
+    assert(cache.size() == 1 && cache.weight() == 3 && *e == "e");
+    cache.set(6, "f", 4);
+    const auto f = cache.get(6);
+    const auto kept = cache.get(5);
+    assert(!f && kept);
+    const auto removed = cache.remove(5);
+    assert(removed && *removed == "e" && cache.weight() == 0);
+
+    ConcurrentClockCache<int, int> expiring(1000, std::chrono::milliseconds(20));
+    expiring.set(1, 1);
+    const auto fresh = expiring.get(1);
+    assert(fresh);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    const auto stale = expiring.get(1);
+    assert(!stale);
+
+    // a capacity under Shards gets fewer shards, and the total stays exact
+    ConcurrentClockCache<int, int> tiny(10);
+    for (int i = 0; i < 100; i++) {
+        tiny.set(i, i);
+    }
+    assert(tiny.shard_count() == 8 && tiny.capacity() == 10 && tiny.size() <= 10);
 
+    // more keys than fit: the cache stays within its capacity throughout
+    ConcurrentClockCache<int, int> bounded(1024);
+    std::vector<std::thread> users;
+    for (int t = 0; t < 4; t++) {
+        users.emplace_back([&, t] {
+            for (int i = 0; i < 50000; i++) {
+                const int k = (i * 31 + t) % 4096;
+                if (auto v = bounded.get(k)) {
+                    assert(*v == k);
+                } else {
+                    bounded.set(k, k);
+                }
+            }
+        });
+    }
+    for (auto &u : users) {
+        u.join();
+    }
+    assert(bounded.size() <= bounded.capacity() && bounded.capacity() == 1024);
+    auto totals = bounded.stats();
+    assert(totals.hits + totals.misses == 200000 && totals.evictions > 0);
     return 0;
 }
@@ -0,0 +1,82 @@
+#include "unordered_map.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+// Every thread locks only its own mutex, so there is no true contention;
+// any slowdown as threads are added comes from mutexes sharing a line.
+// Then the same sweep over ConcurrentHashMap with 1, 8 and 64 stripes.
+
+using Clock = std::chrono::steady_clock;
+constexpr auto run_for = std::chrono::milliseconds(200);
+
+struct Packed {
+    std::shared_mutex m_;
+};
+struct alignas(64) Padded {
+    std::shared_mutex m_;
+};
+
+template<typename Work>
+double run(unsigned threads, Work &&work) {
+    std::atomic<bool> stop{false};
+    std::atomic<unsigned long> total{0};
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            unsigned long ops = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 256; i++) {
+                    work(t, ops++);
+                }
+            }
+            total += ops;
+        });
+    }
+    std::this_thread::sleep_for(run_for);
+    stop = true;
+    for (auto &w : workers) {
+        w.join();
+    }
+    return total / std::chrono::duration<double>(run_for).count();
+}
+
+template<typename Lock>
+double lock_only(unsigned threads) {
+    std::vector<Lock> locks(threads);
+    return run(threads, [&](unsigned t, unsigned long) {
+        std::unique_lock xlock(locks[t].m_);
+    });
+}
+
+template<std::size_t Stripes>
+double map_mixed(unsigned threads) {
+    ConcurrentHashMap<int, int> map(64, lock_stripes{Stripes});
+    const int keys = 1 << 16;
+    for (int i = 0; i < keys; i++) {
+        map.set(i, i);
+    }
+    return run(threads, [&](unsigned t, unsigned long op) {
+        int k = static_cast<int>((op * 2654435761u + t * 40503u) & (keys - 1));
+        if (op % 10 == 0) {
+            map.set(k, k);
+        } else {
+            map.visit(k, [](const int &) {});
+        }
+    });
+}
+
+int main(int argc, char *argv[]) {
+    unsigned max_threads = argc > 1 ? std::atoi(argv[1]) : 2 * std::thread::hardware_concurrency();
+    std::printf("%8s %14s %14s %14s %14s %14s\n", "threads", "packed lock", "padded lock",
+                "map 1 stripe", "map 8 stripes", "map 64 stripes");
+    for (unsigned threads = 1; threads <= std::max(1u, max_threads); threads *= 2) {
+        std::printf("%8u %14.3e %14.3e %14.3e %14.3e %14.3e\n", threads,
+                    lock_only<Packed>(threads), lock_only<Padded>(threads),
+                    map_mixed<1>(threads), map_mixed<8>(threads), map_mixed<64>(threads));
+    }
+    return 0;
+}
@@ -0,0 +1,380 @@
+#ifndef FLAT_TABLE_H_
+#define FLAT_TABLE_H_
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Single-threaded open-addressing table in the style of a Swiss table.
+// Slots are grouped 16 at a time; every slot has one control byte that is
+// either empty, deleted, or the low 7 bits of the key's hash, so a probe
+// compares a whole group with one SIMD compare and touches a slot only on a
+// fragment match. Callers pass in the (already mixed) hash; the full hash
+// is kept in the slot so rehashing never calls the hasher again.
+template<typename K, typename V>
+class FlatTable {
+public:
+    struct Slot {
+        std::size_t hash;
+        K key;
+        V value;
+    };
+
+private:
+    static constexpr std::size_t group_width = 16;
+    static constexpr std::uint8_t ctrl_empty = 0x80;
+    static constexpr std::uint8_t ctrl_deleted = 0xfe;
+
+    class Group {
+    private:
+        const std::uint8_t *ctrl;
+    public:
+        explicit Group(const std::uint8_t *ctrl) : ctrl(ctrl) {};
+#if defined(__SSE2__)
+        std::uint32_t match(std::uint8_t h2) const {
+            auto g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(static_cast<char>(h2))));
+        };
+        std::uint32_t match_empty() const { return match(ctrl_empty); };
+        // empty and deleted are the only control bytes with the top bit set
+        std::uint32_t match_empty_or_deleted() const {
+            auto g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+            return _mm_movemask_epi8(g);
+        };
+#else
+        std::uint32_t match(std::uint8_t h2) const {
+            std::uint32_t bits = 0;
+            for (std::size_t i = 0; i < group_width; i++) {
+                bits |= std::uint32_t(ctrl[i] == h2) << i;
+            }
+            return bits;
+        };
+        std::uint32_t match_empty() const { return match(ctrl_empty); };
+        std::uint32_t match_empty_or_deleted() const {
+            std::uint32_t bits = 0;
+            for (std::size_t i = 0; i < group_width; i++) {
+                bits |= std::uint32_t(ctrl[i] >> 7) << i;
+            }
+            return bits;
+        };
+#endif
+    };
+
+    static std::size_t lowest_bit(std::uint32_t bits) {
+        return static_cast<std::size_t>(__builtin_ctz(bits));
+    };
+    static std::uint8_t h2(std::size_t hash) { return hash & 0x7f; };
+    static std::size_t h1(std::size_t hash) { return hash >> 7; };
+    // keep the load factor at or below 7/8
+    static std::size_t max_load(std::size_t capacity) { return capacity - capacity / 8; };
+
+    std::unique_ptr<std::uint8_t[]> ctrl;
+    Slot *slots = nullptr;
+    std::size_t capacity_ = 0;
+    std::size_t size_ = 0;
+    std::size_t growth_left = 0;
+
+    template<typename F>
+    std::size_t probe(std::size_t hash, F &&f) const {
+        const std::size_t group_mask = capacity_ / group_width - 1;
+        std::size_t g = h1(hash) & group_mask;
+        for (std::size_t i = 1;; i++) {
+            std::size_t found = f(g * group_width, Group(ctrl.get() + g * group_width));
+            if (found != capacity_) {
+                return found;
+            }
+            g = (g + i) & group_mask;
+        }
+    };
+
+    std::size_t find_index(const K &k, std::size_t hash) const {
+        if (capacity_ == 0) {
+            return 0;
+        }
+        return probe(hash, [&](std::size_t base, Group g) -> std::size_t {
+            for (auto bits = g.match(h2(hash)); bits; bits &= bits - 1) {
+                std::size_t i = base + lowest_bit(bits);
+                if (slots[i].hash == hash && slots[i].key == k) {
+                    return i;
+                }
+            }
+            return g.match_empty() ? capacity_ + 1 : capacity_;
+        });
+    };
+
+    std::size_t find_insert_index(std::size_t hash) const {
+        return probe(hash, [&](std::size_t base, Group g) -> std::size_t {
+            auto bits = g.match_empty_or_deleted();
+            return bits ? base + lowest_bit(bits) : capacity_;
+        });
+    };
+
+    void set_ctrl(std::size_t i, std::uint8_t c) { ctrl[i] = c; };
+
+    static Slot *allocate_slots(std::size_t n) {
+        return static_cast<Slot *>(::operator new(n * sizeof(Slot), std::align_val_t(alignof(Slot))));
+    };
+    static void deallocate_slots(Slot *p) {
+        ::operator delete(p, std::align_val_t(alignof(Slot)));
+    };
+
+    void destroy_all() {
+        for (std::size_t i = 0; i < capacity_; i++) {
+            if (!(ctrl[i] & 0x80)) {
+                slots[i].~Slot();
+            }
+        }
+        if (slots) {
+            deallocate_slots(slots);
+        }
+    };
+
+    // places a slot known not to be present; requires growth_left > 0
+    template<typename KK, typename... Args>
+    Slot *insert_new(std::size_t hash, KK &&k, Args &&...args) {
+        std::size_t i = find_insert_index(hash);
+        Slot *s = ::new (slots + i) Slot{hash, K(std::forward<KK>(k)), V(std::forward<Args>(args)...)};
+        if (ctrl[i] == ctrl_empty) {
+            growth_left--;
+        }
+        set_ctrl(i, h2(hash));
+        size_++;
+        return s;
+    };
+
+    void rehash(std::size_t new_capacity) {
+        FlatTable next(new_capacity);
+        for (std::size_t i = 0; i < capacity_; i++) {
+            if (!(ctrl[i] & 0x80)) {
+                next.insert_new(slots[i].hash, std::move(slots[i].key), std::move(slots[i].value));
+            }
+        }
+        swap(next);
+    };
+
+    void reserve_one() {
+        if (growth_left == 0) {
+            rehash(next_capacity());
+        }
+    };
+
+public:
+    FlatTable() = default;
+    explicit FlatTable(std::size_t capacity) {
+        std::size_t cap = group_width;
+        while (cap < capacity) {
+            cap <<= 1;
+        }
+        ctrl.reset(new std::uint8_t[cap]);
+        std::memset(ctrl.get(), ctrl_empty, cap);
+        slots = allocate_slots(cap);
+        capacity_ = cap;
+        growth_left = max_load(cap);
+    };
+    FlatTable(const FlatTable &) = delete;
+    FlatTable &operator=(const FlatTable &) = delete;
+    FlatTable(FlatTable &&other) noexcept { swap(other); };
+    FlatTable &operator=(FlatTable &&other) noexcept {
+        FlatTable tmp(std::move(other));
+        swap(tmp);
+        return *this;
+    };
+    ~FlatTable() { destroy_all(); };
+
+    void swap(FlatTable &other) noexcept {
+        std::swap(ctrl, other.ctrl);
+        std::swap(slots, other.slots);
+        std::swap(capacity_, other.capacity_);
+        std::swap(size_, other.size_);
+        std::swap(growth_left, other.growth_left);
+    };
+
+    Slot *find(const K &k, std::size_t hash) {
+        std::size_t i = find_index(k, hash);
+        return i < capacity_ ? slots + i : nullptr;
+    };
+    const Slot *find(const K &k, std::size_t hash) const {
+        std::size_t i = find_index(k, hash);
+        return i < capacity_ ? slots + i : nullptr;
+    };
+
+    // returns the slot for k and whether it was inserted
+    template<typename KK, typename... Args>
+    std::pair<Slot *, bool> try_emplace(std::size_t hash, KK &&k, Args &&...args) {
+        if (Slot *s = find(k, hash)) {
+            return {s, false};
+        }
+        reserve_one();
+        return {insert_new(hash, std::forward<KK>(k), std::forward<Args>(args)...), true};
+    };
+
+    // places a key known to be absent; requires !full()
+    template<typename KK, typename... Args>
+    Slot *emplace_new(std::size_t hash, KK &&k, Args &&...args) {
+        return insert_new(hash, std::forward<KK>(k), std::forward<Args>(args)...);
+    };
+
+    // moves the live slots in [first, first + n) out through f. The slots
+    // become tombstones, not empty, so probes for keys further along the
+    // same sequence still reach them.
+    template<typename F>
+    void drain(std::size_t first, std::size_t n, F &&f) {
+        for (std::size_t i = first; i < first + n; i++) {
+            if (!(ctrl[i] & 0x80)) {
+                f(slots[i].hash, std::move(slots[i].key), std::move(slots[i].value));
+                slots[i].~Slot();
+                set_ctrl(i, ctrl_deleted);
+                size_--;
+            }
+        }
+    };
+
+    void reserve(std::size_t n) {
+        std::size_t cap = capacity_for(n);
+        if (cap > capacity_) {
+            rehash(cap);
+        }
+    };
+
+    static std::size_t capacity_for(std::size_t n) {
+        std::size_t cap = group_width;
+        while (max_load(cap) < n) {
+            cap <<= 1;
+        }
+        return cap;
+    };
+    // capacity to move to once full: doubled, unless the table is mostly
+    // tombstones, in which case rebuilding at the same size is enough
+    std::size_t next_capacity() const {
+        if (capacity_ == 0) {
+            return group_width;
+        }
+        return size_ < max_load(capacity_) / 2 ? capacity_ : capacity_ * 2;
+    };
+    bool full() const { return growth_left == 0; };
+    bool owns(const Slot *s) const { return s >= slots && s < slots + capacity_; };
+
+    void erase(Slot *s) {
+        std::size_t i = s - slots;
+        s->~Slot();
+        set_ctrl(i, ctrl_deleted);
+        size_--;
+    };
+
+    template<typename F>
+    void for_each(F &&f) const {
+        for (std::size_t i = 0; i < capacity_; i++) {
+            if (!(ctrl[i] & 0x80)) {
+                f(static_cast<const K &>(slots[i].key), static_cast<const V &>(slots[i].value));
+            }
+        }
+    };
+
+    std::size_t size() const { return size_; };
+    std::size_t capacity() const { return capacity_; };
+};
+
+// FlatTable that never rehashes all at once. When the current table fills
+// up, it becomes the old table and a larger one takes over; every later
+// write moves the next migrate_step slots across, and lookups check both
+// tables until the old one is empty. The migration rate guarantees the old
+// table drains before the new one can fill.
+template<typename K, typename V>
+class IncrementalTable {
+public:
+    using Table = FlatTable<K, V>;
+    using Slot = typename Table::Slot;
+
+private:
+    static constexpr std::size_t migrate_step = 32;
+    Table table;
+    Table old;
+    std::size_t migrate_pos = 0;
+
+    bool migrating() const { return old.capacity() != 0; };
+
+    void migrate(std::size_t n) {
+        const std::size_t end = std::min(migrate_pos + n, old.capacity());
+        old.drain(migrate_pos, end - migrate_pos, [this](std::size_t h, K &&k, V &&v) {
+            table.emplace_new(h, std::move(k), std::move(v));
+        });
+        migrate_pos = end;
+        if (migrate_pos == old.capacity()) {
+            old = Table();
+            migrate_pos = 0;
+        }
+    };
+
+    void prepare_insert() {
+        if (migrating()) {
+            migrate(migrate_step);
+        }
+        if (!table.full()) {
+            return;
+        }
+        if (migrating()) {
+            migrate(old.capacity());
+        }
+        Table next(table.next_capacity());
+        old = std::move(table);
+        table = std::move(next);
+    };
+
+public:
+    Slot *find(const K &k, std::size_t hash) {
+        if (Slot *s = table.find(k, hash)) {
+            return s;
+        }
+        return migrating() ? old.find(k, hash) : nullptr;
+    };
+    const Slot *find(const K &k, std::size_t hash) const {
+        if (const Slot *s = table.find(k, hash)) {
+            return s;
+        }
+        return migrating() ? old.find(k, hash) : nullptr;
+    };
+
+    template<typename KK, typename... Args>
+    std::pair<Slot *, bool> try_emplace(std::size_t hash, KK &&k, Args &&...args) {
+        if (Slot *s = find(k, hash)) {
+            return {s, false};
+        }
+        prepare_insert();
+        return {table.emplace_new(hash, std::forward<KK>(k), std::forward<Args>(args)...), true};
+    };
+
+    void erase(Slot *s) {
+        if (old.owns(s)) {
+            old.erase(s);
+        } else {
+            table.erase(s);
+        }
+        if (migrating()) {
+            migrate(migrate_step);
+        }
+    };
+
+    template<typename F>
+    void for_each(F &&f) const {
+        table.for_each(f);
+        old.for_each(f);
+    };
+
+    // sizes the table for n entries up front; finishes any pending migration
+    void reserve(std::size_t n) {
+        if (migrating()) {
+            migrate(old.capacity());
+        }
+        table.reserve(n);
+    };
+
+    std::size_t size() const { return table.size() + old.size(); };
+    std::size_t capacity() const { return table.capacity(); };
+};
+#endif // FLAT_TABLE_H_
@@ -0,0 +1,234 @@
+#ifndef RCU_HASH_MAP_H_
+#define RCU_HASH_MAP_H_
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include "reclaim.h"
+
+// Read-optimized counterpart of ConcurrentHashMap with the same
+// get/set/remove surface. Readers take no lock: they pin an epoch and walk
+// immutable nodes with acquire loads. Writers serialize per lock stripe,
+// publish a fresh node for every insert or update and retire the node it
+// replaces through EpochReclaim. Readers walk whole chains and a whole
+// table, which hazard pointers could only protect node by node, so this map
+// stays on epochs.
+//
+// Growing builds the bigger table one stripe at a time while readers keep
+// using the current one and writers keep writing. Every bucket belongs to a
+// single stripe, so copying a stripe's buckets only holds that stripe's
+// lock; until the new table is published, writes to a stripe that was
+// already copied go to both tables.
+template<typename K, typename V, typename Hash=std::hash<K>>
+class RcuHashMap {
+private:
+    struct Node {
+        const std::size_t hash;
+        const K key;
+        const V value;
+        std::atomic<Node *> next;
+    };
+    struct Table {
+        const std::size_t mask;
+        std::unique_ptr<std::atomic<Node *>[]> heads;
+        explicit Table(std::size_t n) : mask(n - 1), heads(new std::atomic<Node *>[n]) {
+            for (std::size_t i = 0; i < n; i++) {
+                heads[i].store(nullptr, std::memory_order_relaxed);
+            }
+        };
+        ~Table() {
+            for (std::size_t i = 0; i <= mask; i++) {
+                Node *n = heads[i].load(std::memory_order_relaxed);
+                while (n) {
+                    Node *next = n->next.load(std::memory_order_relaxed);
+                    delete n;
+                    n = next;
+                }
+            }
+        };
+    };
+    struct alignas(64) Stripe {
+        std::mutex m_;
+        // the table being grown into once this stripe's buckets are copied
+        // there; guarded by m_
+        Table *copied_to = nullptr;
+    };
+
+    // chains longer than this on average trigger a grow
+    static constexpr std::size_t max_load = 2;
+
+    std::atomic<Table *> table;
+    std::unique_ptr<Stripe[]> stripes;
+    const std::size_t stripe_mask;
+    // one grow at a time; readers and writers never take it
+    std::mutex grow_m_;
+    std::atomic<std::size_t> count{0};
+    Hash hasher;
+
+    static std::size_t round_up(std::size_t n) {
+        std::size_t cap = 1;
+        while (cap < n) {
+            cap <<= 1;
+        }
+        return cap;
+    };
+    std::size_t hash(const K &k) const {
+        std::size_t h = hasher(k);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    };
+
+    // walks the chain with acquire loads; only valid under an EpochGuard
+    static const Node *find(const Table *t, const K &k, std::size_t h) {
+        for (const Node *n = t->heads[h & t->mask].load(std::memory_order_acquire); n;
+             n = n->next.load(std::memory_order_acquire)) {
+            if (n->hash == h && n->key == k) {
+                return n;
+            }
+        }
+        return nullptr;
+    };
+    // the write paths, for one table; the caller holds the key's stripe
+    static bool put(Table *t, const K &k, const V &v, std::size_t h) {
+        std::atomic<Node *> *link = &t->heads[h & t->mask];
+        for (Node *n = link->load(std::memory_order_relaxed); n;
+             link = &n->next, n = n->next.load(std::memory_order_relaxed)) {
+            if (n->hash == h && n->key == k) {
+                link->store(new Node{h, k, v, n->next.load(std::memory_order_relaxed)},
+                            std::memory_order_release);
+                EpochReclaim::retire(n);
+                return false;
+            }
+        }
+        auto &head = t->heads[h & t->mask];
+        head.store(new Node{h, k, v, head.load(std::memory_order_relaxed)}, std::memory_order_release);
+        return true;
+    };
+    static Node *unlink(Table *t, const K &k, std::size_t h) {
+        std::atomic<Node *> *link = &t->heads[h & t->mask];
+        for (Node *n = link->load(std::memory_order_relaxed); n;
+             link = &n->next, n = n->next.load(std::memory_order_relaxed)) {
+            if (n->hash == h && n->key == k) {
+                link->store(n->next.load(std::memory_order_relaxed), std::memory_order_release);
+                return n;
+            }
+        }
+        return nullptr;
+    };
+    // the table a stripe's writes must also reach while t is being grown
+    Table *shadow(const Stripe &s, const Table *t) const {
+        return s.copied_to != t ? s.copied_to : nullptr;
+    };
+
+    void grow() {
+        std::lock_guard<std::mutex> glock(grow_m_);
+        Table *old = table.load(std::memory_order_relaxed);
+        if (count.load(std::memory_order_relaxed) <= (old->mask + 1) * max_load) {
+            return;
+        }
+        // nodes cannot be shared between tables since their next links
+        // differ, so the new table gets its own copies
+        Table *fresh = new Table((old->mask + 1) * 2);
+        for (std::size_t s = 0; s <= stripe_mask; s++) {
+            std::lock_guard<std::mutex> lk(stripes[s].m_);
+            for (std::size_t i = s; i <= old->mask; i += stripe_mask + 1) {
+                for (Node *n = old->heads[i].load(std::memory_order_relaxed); n;
+                     n = n->next.load(std::memory_order_relaxed)) {
+                    auto &head = fresh->heads[n->hash & fresh->mask];
+                    head.store(new Node{n->hash, n->key, n->value, head.load(std::memory_order_relaxed)},
+                               std::memory_order_relaxed);
+                }
+            }
+            stripes[s].copied_to = fresh;
+        }
+        table.store(fresh, std::memory_order_release);
+        EpochReclaim::retire(old);
+    };
+
+public:
+    explicit RcuHashMap(std::size_t num_buckets = 1024, std::size_t num_stripes = 64)
+        : stripe_mask(round_up(num_stripes) - 1) {
+        table.store(new Table(round_up(std::max(num_buckets, stripe_mask + 1))),
+                    std::memory_order_relaxed);
+        stripes.reset(new Stripe[stripe_mask + 1]);
+    };
+    RcuHashMap(const RcuHashMap&) = delete;
+    RcuHashMap& operator=(const RcuHashMap&) = delete;
+    ~RcuHashMap() { delete table.load(std::memory_order_relaxed); };
+
+    // Returns a copy of the value, so every hit allocates; readers that
+    // only need to look at it should use visit, which copies nothing.
+    std::shared_ptr<V> get(const K &k) {
+        const auto h = hash(k);
+        EpochReclaim::Guard guard;
+        const Node *n = find(table.load(std::memory_order_acquire), k, h);
+        return n ? std::make_shared<V>(n->value) : nullptr;
+    };
+    // calls f on the stored value without copying it; returns false if absent
+    template<typename F>
+    bool visit(const K &k, F &&f) {
+        const auto h = hash(k);
+        EpochReclaim::Guard guard;
+        const Node *n = find(table.load(std::memory_order_acquire), k, h);
+        if (!n) {
+            return false;
+        }
+        f(n->value);
+        return true;
+    };
+
+    void set(const K &k, const V &v) {
+        const auto h = hash(k);
+        bool inserted;
+        std::size_t buckets;
+        {
+            // the guard keeps a table retired by a concurrent grow alive
+            EpochReclaim::Guard guard;
+            // the table always has at least as many buckets as there are
+            // stripes, so one stripe covers every node of a chain
+            Stripe &s = stripes[h & stripe_mask];
+            std::lock_guard<std::mutex> lk(s.m_);
+            Table *t = table.load(std::memory_order_acquire);
+            buckets = t->mask + 1;
+            inserted = put(t, k, v, h);
+            if (Table *next = shadow(s, t)) {
+                put(next, k, v, h);
+            }
+        }
+        if (inserted && count.fetch_add(1, std::memory_order_relaxed) + 1 > buckets * max_load) {
+            grow();
+        }
+    };
+    std::shared_ptr<V> remove(const K &k) {
+        const auto h = hash(k);
+        EpochReclaim::Guard guard;
+        Stripe &s = stripes[h & stripe_mask];
+        std::lock_guard<std::mutex> lk(s.m_);
+        Table *t = table.load(std::memory_order_acquire);
+        Node *n = unlink(t, k, h);
+        if (!n) {
+            return nullptr;
+        }
+        // a copied stripe holds the same keys in both tables
+        Table *next = shadow(s, t);
+        if (Node *copy = next ? unlink(next, k, h) : nullptr) {
+            EpochReclaim::retire(copy);
+        }
+        count.fetch_sub(1, std::memory_order_relaxed);
+        auto p = std::make_shared<V>(n->value);
+        EpochReclaim::retire(n);
+        return p;
+    };
+
+    std::size_t size() const { return count.load(std::memory_order_relaxed); };
+    std::size_t bucket_count() const {
+        EpochReclaim::Guard guard;
+        return table.load(std::memory_order_acquire)->mask + 1;
+    };
+};
+#endif // RCU_HASH_MAP_H_
@@ -4,13 +4,15 @@
 #include <cstddef>
 #include <functional>
 #include <utility>
-#include <list>
 #include <vector>
 #include <mutex>
 #include <shared_mutex>
 #include <memory>
 #include <thread>
-#include <future>
+#include <atomic>
+#include <iterator>
+#include "flat_table.h"
+#include "metrics.h"
 
 // class K {
 //     public:
@@ -29,89 +31,352 @@
 
 // using Hash = std::hash<K>;
 
-template<typename K, typename V, typename Hash=std::hash<K>>
+// Number of lock stripes, passed to ConcurrentHashMap's constructor after
+// the bucket count so the two cannot be mixed up.
+struct lock_stripes {
+    std::size_t count;
+};
+
+// The map is split into buckets, each an independently growing flat table,
+// whose count is set at construction. Locking is decoupled from it: buckets
+// are spread over lock stripes, each on its own cache line. SharedMutex is
+// the stripe lock type and must be SharedLockable. Metrics is a hook policy
+// from metrics.h: lookups count as hits or misses, inserts as added and
+// erases as removed.
+template<typename K, typename V, typename Hash=std::hash<K>,
+         typename SharedMutex=std::shared_mutex, typename Metrics=no_metrics>
 class ConcurrentHashMap {
 private:
-    class Bucket {
+    static constexpr std::size_t cache_line = 64;
+    struct alignas(cache_line) Stripe {
+        mutable SharedMutex m_;
+    };
+    class alignas(cache_line) Bucket {
     private:
-        using Pair = std::pair<K, V>;
-        using List = std::list<Pair>;
-        using Iter = typename List::iterator;
-        List list;
-        Iter find(const K &k)  {
-            return std::find_if(list.begin(), list.end(), [&](const Pair &pair) -> bool {return k == pair.first;});
-        };
+        using Table = IncrementalTable<K, V>;
+        Table table;
+        // written under the exclusive lock, read without any lock by size()
+        std::atomic<std::size_t> count{0};
+        void update_count() { count.store(table.size(), std::memory_order_relaxed); };
 
     public:
-        mutable std::shared_mutex m_;
-        std::shared_ptr<V> get(const K &k){
+        SharedMutex &m_;
+        explicit Bucket(SharedMutex &m) : m_(m) {};
+        std::shared_ptr<V> get(const K &k, std::size_t h){
             std::shared_lock slock(m_);
-            auto it = find(k);
-            return it == list.end() ? nullptr : std::make_shared<V>(it->second);
+            auto s = table.find(k, h);
+            return s ? std::make_shared<V>(s->value) : nullptr;
         };
 
-        void set(const K& k, const V &v) {
+        // true if k was not present
+        template<typename KK, typename VV>
+        bool set(KK &&k, VV &&v, std::size_t h) {
             std::unique_lock xlock(m_);
-            auto it = find(k);
-            if (it == list.end()) {
-                list.push_back(Pair(k, v));
-            } else {
-                it->second = v;
+            // the value is only consumed when a new slot is created
+            auto [s, inserted] = table.try_emplace(h, std::forward<KK>(k), std::forward<VV>(v));
+            if (!inserted) {
+                s->value = std::forward<VV>(v);
+            }
+            update_count();
+            return inserted;
+        }
+        template<typename F>
+        bool visit(const K &k, std::size_t h, F &f) const {
+            std::shared_lock slock(m_);
+            auto s = table.find(k, h);
+            if (!s) {
+                return false;
+            }
+            f(static_cast<const V &>(s->value));
+            return true;
+        }
+        template<typename F>
+        bool visit_mut(const K &k, std::size_t h, F &f) {
+            std::unique_lock xlock(m_);
+            auto s = table.find(k, h);
+            if (!s) {
+                return false;
+            }
+            f(s->value);
+            return true;
+        }
+        template<typename KK, typename Make, typename Update>
+        bool upsert(KK &&k, std::size_t h, Make &make, Update &update) {
+            std::unique_lock xlock(m_);
+            if (auto s = table.find(k, h)) {
+                update(s->value);
+                return false;
+            }
+            table.try_emplace(h, std::forward<KK>(k), make());
+            update_count();
+            return true;
+        }
+        template<typename KK, typename... Args>
+        bool try_emplace(KK &&k, std::size_t h, Args &&...args) {
+            std::unique_lock xlock(m_);
+            bool inserted = table.try_emplace(h, std::forward<KK>(k), std::forward<Args>(args)...).second;
+            update_count();
+            return inserted;
+        }
+        template<typename F>
+        bool compute_if_present(const K &k, std::size_t h, F &f) {
+            std::unique_lock xlock(m_);
+            auto s = table.find(k, h);
+            if (!s) {
+                return false;
             }
+            if (!f(s->value)) {
+                table.erase(s);
+                update_count();
+            }
+            return true;
         }
-        std::shared_ptr<V> remove(const K& k) {
+        std::shared_ptr<V> remove(const K& k, std::size_t h) {
             std::unique_lock xlock(m_);
-            auto it = find(k);
-            if (it == list.end()) {
+            auto s = table.find(k, h);
+            if (!s) {
                 return nullptr;
             } else {
-                auto p = std::make_shared<V>(it->second);
-                list.erase(it);
+                auto p = std::make_shared<V>(std::move(s->value));
+                table.erase(s);
+                update_count();
                 return p;
             }
         }
-        void dump() {
-
+        void reserve(std::size_t n) {
+            std::unique_lock xlock(m_);
+            table.reserve(n);
+        }
+        std::size_t size() const {
+            return count.load(std::memory_order_relaxed);
+        }
+        std::size_t capacity() const {
+            std::shared_lock slock(m_);
+            return table.capacity();
+        }
+        template<typename F>
+        void for_each(F &f) const {
+            std::shared_lock slock(m_);
+            table.for_each(f);
+        }
+        // caller holds the stripe lock
+        void copy_to(std::vector<std::pair<K, V>> &out) const {
+            out.reserve(out.size() + table.size());
+            table.for_each([&](const K &k, const V &v) { out.emplace_back(k, v); });
         }
 
     };
 private:
+    static constexpr std::size_t chunk_size = 8;
+    std::unique_ptr<Stripe[]> stripes;
+    std::size_t num_stripes;
     std::vector<std::unique_ptr<Bucket>> buckets;
     Hash hasher;
-    Bucket& get_bucket(const K &k) {
-        const auto i = hasher(k) % buckets.size();
+    mutable Metrics metrics_;
+    bool lookup(bool found) const {
+        if (found) {
+            metrics_.hit();
+        } else {
+            metrics_.missed();
+        }
+        return found;
+    };
+    bool inserted(bool added) {
+        if (added) {
+            metrics_.added();
+        }
+        return added;
+    };
+    static std::size_t round_up(std::size_t n) {
+        std::size_t cap = 1;
+        while (cap < n) {
+            cap <<= 1;
+        }
+        return cap;
+    };
+    // std::hash is the identity for integers; spread the bits before the
+    // low 7 become control bytes and the high half picks the bucket
+    std::size_t hash(const K &k) const {
+        std::size_t h = hasher(k);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    };
+    Bucket& get_bucket(std::size_t h) const {
+        const auto i = (h >> 32) & (buckets.size() - 1);
         return *buckets[i];
     };
+    // runs f(i) for every bucket index on up to n_workers threads, which
+    // claim chunk_size buckets at a time
+    template<typename F>
+    void parallel_buckets(unsigned n_workers, F &&f) const {
+        const std::size_t chunks = (buckets.size() + chunk_size - 1) / chunk_size;
+        n_workers = static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(n_workers, chunks)));
+        std::atomic<std::size_t> next{0};
+        auto work = [&] {
+            for (std::size_t c; (c = next.fetch_add(1, std::memory_order_relaxed)) < chunks;) {
+                const std::size_t end = std::min(buckets.size(), (c + 1) * chunk_size);
+                for (std::size_t i = c * chunk_size; i < end; i++) {
+                    f(i);
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        workers.reserve(n_workers - 1);
+        for (unsigned w = 1; w < n_workers; w++) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto &t : workers) {
+            t.join();
+        }
+    };
 public:
-    explicit ConcurrentHashMap(size_t num_buckets = 19) : buckets(num_buckets) {
-        for (int i = 0; i < buckets.size(); i++) {
-            buckets[i].reset(new Bucket);
+    // num_buckets is rounded up to a power of two so the bucket index is a
+    // mask; by default every bucket gets its own lock stripe
+    explicit ConcurrentHashMap(std::size_t num_buckets = 64)
+        : ConcurrentHashMap(num_buckets, lock_stripes{num_buckets}) {};
+    // Stripes are rounded up to a power of two. A stripe guards whole
+    // buckets, so there are never more stripes than buckets: extra ones
+    // would guard nothing.
+    ConcurrentHashMap(std::size_t num_buckets, lock_stripes n_stripes)
+        : num_stripes(round_up(n_stripes.count)), buckets(round_up(num_buckets)) {
+        num_stripes = std::min(num_stripes, buckets.size());
+        stripes.reset(new Stripe[num_stripes]);
+        for (std::size_t i = 0; i < buckets.size(); i++) {
+            buckets[i].reset(new Bucket(stripes[i & (num_stripes - 1)].m_));
         }
     };
     ConcurrentHashMap(const ConcurrentHashMap&) = delete;
     ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
 
     std::shared_ptr<V> get(const K &k) {
-        return get_bucket(k).get(k);
+        const auto h = hash(k);
+        auto p = get_bucket(h).get(k, h);
+        lookup(p != nullptr);
+        return p;
     };
     void set(const K &k, const V &v) {
-        get_bucket(k).set(k, v);
+        const auto h = hash(k);
+        inserted(get_bucket(h).set(k, v, h));
+    };
+    void set(K &&k, V &&v) {
+        const auto h = hash(k);
+        inserted(get_bucket(h).set(std::move(k), std::move(v), h));
+    };
+    // f(const V&) runs under the bucket's shared lock; false if k is absent
+    template<typename F>
+    bool visit(const K &k, F &&f) const {
+        const auto h = hash(k);
+        return lookup(get_bucket(h).visit(k, h, f));
+    };
+    // f(V&) mutates the stored value in place under the bucket's exclusive lock
+    template<typename F>
+    bool visit_mut(const K &k, F &&f) {
+        const auto h = hash(k);
+        return lookup(get_bucket(h).visit_mut(k, h, f));
+    };
+    // inserts make() if k is absent, otherwise calls update(V&); one lock
+    // acquisition either way. Returns true if the value was inserted.
+    template<typename Make, typename Update>
+    bool upsert(const K &k, Make &&make, Update &&update) {
+        const auto h = hash(k);
+        return inserted(get_bucket(h).upsert(k, h, make, update));
+    };
+    // constructs V from args only if k is absent; returns true if inserted
+    template<typename... Args>
+    bool try_emplace(const K &k, Args &&...args) {
+        const auto h = hash(k);
+        return inserted(get_bucket(h).try_emplace(k, h, std::forward<Args>(args)...));
+    };
+    // f(V&) returns false to erase the entry; returns false if k is absent
+    template<typename F>
+    bool compute_if_present(const K &k, F &&f) {
+        const auto h = hash(k);
+        bool erased = false;
+        auto keep = [&](V &v) {
+            erased = !f(v);
+            return !erased;
+        };
+        if (!lookup(get_bucket(h).compute_if_present(k, h, keep))) {
+            return false;
+        }
+        if (erased) {
+            metrics_.removed();
+        }
+        return true;
     };
     std::shared_ptr<V> remove(const K &k) {
-        return get_bucket(k).remove(k);
+        const auto h = hash(k);
+        auto p = get_bucket(h).remove(k, h);
+        if (p) {
+            metrics_.removed();
+        } else {
+            metrics_.missed();
+        }
+        return p;
+    };
+    // pre-sizes every bucket so n entries fit without any migration
+    void reserve(std::size_t n) {
+        const std::size_t per_bucket = (n + buckets.size() - 1) / buckets.size();
+        for (auto &b : buckets) {
+            b->reserve(per_bucket + per_bucket / 8);
+        }
     };
-    void dump() {
-        std::vector<std::shared_lock<std::shared_mutex>> locks; locks.reserve(buckets.size());
-        std::vector<std::future<void>> tasks; tasks.reserve(buckets.size());
-        for (int i = 0; i < buckets.size(); i++) {
-            locks.push_back(std::shared_lock(buckets[i]->m_));
+    // total slots across all buckets
+    std::size_t bucket_count() const {
+        std::size_t n = 0;
+        for (auto &b : buckets) {
+            n += b->capacity();
         }
-        for (int i = 0; i < buckets.size(); i++) {
-            tasks.push_back(std::async([this, i]{buckets[i]->dump();}));
+        return n;
+    };
+    float load_factor() const {
+        std::size_t size = 0, slots = 0;
+        for (auto &b : buckets) {
+            size += b->size();
+            slots += b->capacity();
         }
-        for (int i = 0; i < buckets.size(); i++) {
-            tasks[i].wait();
+        return slots == 0 ? 0.0f : static_cast<float>(size) / slots;
+    };
+    // sum of per-bucket counters; takes no locks, so concurrent writes may
+    // or may not be reflected
+    std::size_t size() const {
+        std::size_t n = 0;
+        for (auto &b : buckets) {
+            n += b->size();
         }
-    }
+        return n;
+    };
+    // Calls f(const K&, const V&) for every entry on n_workers threads. The
+    // buckets are handed out in chunks and each is held under its shared
+    // lock only while it is visited, so writers are delayed by at most one
+    // bucket's worth of work; entries are not a single point-in-time view.
+    template<typename F>
+    void for_each_parallel(F &&f, unsigned n_workers = std::thread::hardware_concurrency()) const {
+        parallel_buckets(n_workers, [&](std::size_t i) { buckets[i]->for_each(f); });
+    };
+    std::size_t stripe_count() const { return num_stripes; };
+    const Metrics &metrics() const { return metrics_; };
+    // Point-in-time copy of the whole map. Every stripe is share-locked
+    // before any is copied, so writers wait for the duration of the copy,
+    // which is spread across n_workers threads to keep that short.
+    std::vector<std::pair<K, V>> snapshot(unsigned n_workers = std::thread::hardware_concurrency()) const {
+        std::vector<std::shared_lock<SharedMutex>> locks;
+        locks.reserve(num_stripes);
+        for (std::size_t i = 0; i < num_stripes; i++) {
+            locks.emplace_back(stripes[i].m_);
+        }
+        std::vector<std::vector<std::pair<K, V>>> parts(buckets.size());
+        parallel_buckets(n_workers, [&](std::size_t i) { buckets[i]->copy_to(parts[i]); });
+        locks.clear();
+        std::vector<std::pair<K, V>> out;
+        out.reserve(size());
+        for (auto &part : parts) {
+            std::move(part.begin(), part.end(), std::back_inserter(out));
+        }
+        return out;
+    };
 };
 #endif // UNORDERED_MAP_H_
@@ -0,0 +1,43 @@
+#include "metrics.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Every thread bumps one shared count in a tight loop: a single
+// std::atomic against a striped_counter. Reported in increments per second.
+
+using Clock = std::chrono::steady_clock;
+constexpr int per_thread = 5000000;
+
+template<typename Add>
+double run(unsigned threads, Add &&add) {
+    const auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (int i = 0; i < per_thread; i++) {
+                add();
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    return threads * double(per_thread) / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main() {
+    const unsigned max_threads = std::max(4u, std::thread::hardware_concurrency());
+    std::printf("%-8s %16s %16s\n", "threads", "std::atomic", "striped_counter");
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        std::atomic<std::int64_t> single{0};
+        striped_counter striped;
+        const double a = run(threads, [&] { single.fetch_add(1, std::memory_order_relaxed); });
+        const double b = run(threads, [&] { striped.add(); });
+        std::printf("%-8u %16.3e %16.3e\n", threads, a, b);
+    }
+    return 0;
+}
@@ -0,0 +1,232 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <thread>
+
+// Statistics that stay off the hot cache lines. A single std::atomic
+// counter bumped by every thread turns into the most contended line in the
+// process; these instead spread writes over per-thread stripes, each on its
+// own line, and pay for it on the (rare) read, which sums the stripes.
+// Everything here is relaxed: values are for reporting, not for
+// synchronization, and a read racing with writers sees some of them.
+
+// a fixed 64 rather than std::hardware_destructive_interference_size: this
+// header is included all over, and GCC warns wherever that constant is used
+inline constexpr std::size_t metrics_cache_line = 64;
+
+// a small per-thread number, handed out in order of first use; threads
+// beyond the stripe count share stripes round-robin
+inline std::size_t metrics_thread_slot() {
+    static std::atomic<std::size_t> next{0};
+    thread_local const std::size_t slot = next.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+inline std::size_t metrics_round_up(std::size_t want) {
+    std::size_t n = 1;
+    while (n < want) {
+        n <<= 1;
+    }
+    return n;
+}
+
+// one stripe per hardware thread, up to 64
+inline std::size_t metrics_default_stripes() {
+    return metrics_round_up(std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1, 64));
+}
+
+class striped_counter {
+private:
+    struct alignas(metrics_cache_line) stripe {
+        std::atomic<std::int64_t> v{0};
+    };
+    std::unique_ptr<stripe[]> stripes;
+    const std::size_t mask;
+
+public:
+    // stripes is rounded up to a power of two
+    explicit striped_counter(std::size_t n_stripes = metrics_default_stripes())
+        : stripes(new stripe[metrics_round_up(n_stripes)]), mask(metrics_round_up(n_stripes) - 1) {}
+    striped_counter(const striped_counter &) = delete;
+    striped_counter &operator=(const striped_counter &) = delete;
+
+    // a stripe can be shared, so this stays an RMW, but an uncontended one
+    void add(std::int64_t n = 1) {
+        stripes[metrics_thread_slot() & mask].v.fetch_add(n, std::memory_order_relaxed);
+    }
+    std::int64_t value() const {
+        std::int64_t sum = 0;
+        for (std::size_t i = 0; i <= mask; i++) {
+            sum += stripes[i].v.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+    // value() and zero, one stripe at a time; adds landing meanwhile are
+    // either in the result or kept for the next call, never lost
+    std::int64_t exchange_zero() {
+        std::int64_t sum = 0;
+        for (std::size_t i = 0; i <= mask; i++) {
+            sum += stripes[i].v.exchange(0, std::memory_order_relaxed);
+        }
+        return sum;
+    }
+};
+
+// Tracks the largest (or, with std::less, smallest) value recorded. A
+// record that does not beat the current extreme is a plain load, so once
+// the extreme settles the line stays shared among all recording threads.
+template<typename Compare>
+class extreme_gauge {
+private:
+    static constexpr std::int64_t initial = Compare()(1, 0) ? std::numeric_limits<std::int64_t>::min()
+                                                            : std::numeric_limits<std::int64_t>::max();
+    alignas(metrics_cache_line) std::atomic<std::int64_t> v{initial};
+
+public:
+    void record(std::int64_t x) {
+        std::int64_t cur = v.load(std::memory_order_relaxed);
+        while (Compare()(x, cur) && !v.compare_exchange_weak(cur, x, std::memory_order_relaxed)) {
+        }
+    }
+    std::int64_t value() const { return v.load(std::memory_order_relaxed); }
+    bool empty() const { return value() == initial; }
+    // for per-interval extremes: returns the current one and starts over
+    std::int64_t reset() { return v.exchange(initial, std::memory_order_relaxed); }
+};
+using max_gauge = extreme_gauge<std::greater<std::int64_t>>;
+using min_gauge = extreme_gauge<std::less<std::int64_t>>;
+
+// Log-linear histogram of nanoseconds: every power of two is split into
+// four buckets, so a bucket's bounds are within 25% of each other. Each
+// stripe has its own counts, and a record is a couple of bit operations
+// and one relaxed increment on the recording thread's stripe.
+class latency_histogram {
+public:
+    static constexpr std::size_t sub_bits = 2;
+    static constexpr std::size_t sub_buckets = std::size_t(1) << sub_bits;
+    static constexpr std::size_t buckets = (64 - sub_bits + 1) * sub_buckets;
+    using counts_t = std::array<std::uint64_t, buckets>;
+
+    static std::size_t bucket_of(std::uint64_t ns) {
+        if (ns < sub_buckets) {
+            return static_cast<std::size_t>(ns);
+        }
+        const std::size_t top = 63 - __builtin_clzll(ns);
+        const std::size_t sub = (ns >> (top - sub_bits)) & (sub_buckets - 1);
+        return (top - sub_bits + 1) * sub_buckets + sub;
+    }
+    // smallest value that lands in bucket i
+    static std::uint64_t lower_bound(std::size_t i) {
+        if (i < sub_buckets) {
+            return i;
+        }
+        const std::size_t top = i / sub_buckets + sub_bits - 1;
+        return (sub_buckets + i % sub_buckets) << (top - sub_bits);
+    }
+    // largest value that lands in bucket i
+    static std::uint64_t upper_bound(std::size_t i) {
+        return i + 1 < buckets ? lower_bound(i + 1) - 1 : std::numeric_limits<std::uint64_t>::max();
+    }
+    // upper bound of the bucket holding quantile q, 0 if nothing recorded
+    static std::uint64_t percentile(const counts_t &counts, double q) {
+        std::uint64_t total = 0;
+        for (auto c : counts) {
+            total += c;
+        }
+        if (total == 0) {
+            return 0;
+        }
+        const auto rank = static_cast<std::uint64_t>(q * static_cast<double>(total - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < buckets; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return upper_bound(i);
+            }
+        }
+        return upper_bound(buckets - 1);
+    }
+
+private:
+    struct alignas(metrics_cache_line) stripe {
+        std::array<std::atomic<std::uint64_t>, buckets> counts{};
+    };
+    std::unique_ptr<stripe[]> stripes;
+    const std::size_t mask;
+
+public:
+    // stripes is rounded up to a power of two
+    explicit latency_histogram(std::size_t n_stripes = metrics_default_stripes())
+        : stripes(new stripe[metrics_round_up(n_stripes)]), mask(metrics_round_up(n_stripes) - 1) {}
+    latency_histogram(const latency_histogram &) = delete;
+    latency_histogram &operator=(const latency_histogram &) = delete;
+
+    void record(std::uint64_t ns) {
+        stripes[metrics_thread_slot() & mask].counts[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+    template<typename Rep, typename Period>
+    void record(std::chrono::duration<Rep, Period> d) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        record(static_cast<std::uint64_t>(std::max<decltype(ns)>(ns, 0)));
+    }
+    counts_t snapshot() const {
+        counts_t out{};
+        for (std::size_t s = 0; s <= mask; s++) {
+            for (std::size_t i = 0; i < buckets; i++) {
+                out[i] += stripes[s].counts[i].load(std::memory_order_relaxed);
+            }
+        }
+        return out;
+    }
+    std::uint64_t percentile(double q) const { return percentile(snapshot(), q); }
+};
+
+// Hook policies for ThreadsafeQueue, threadsafe_stack and ConcurrentHashMap,
+// which take one as their Metrics parameter. The containers report
+// added/removed elements, lookups that hit or missed (including pops from
+// an empty container), and how long blocking pops waited. The default
+// no_metrics compiles every hook away.
+struct no_metrics {
+    struct timer {};
+    timer start() const { return {}; }
+    void added(std::size_t = 1) {}
+    void removed(std::size_t = 1) {}
+    void hit() {}
+    void missed() {}
+    void waited(const timer &) {}
+};
+
+class container_metrics {
+public:
+    using clock = std::chrono::steady_clock;
+    struct timer {
+        clock::time_point start;
+    };
+
+    striped_counter adds;
+    striped_counter removes;
+    striped_counter hits;
+    striped_counter misses;
+    latency_histogram wait;
+    max_gauge max_wait_ns;
+
+    timer start() const { return {clock::now()}; }
+    void added(std::size_t n = 1) { adds.add(static_cast<std::int64_t>(n)); }
+    void removed(std::size_t n = 1) { removes.add(static_cast<std::int64_t>(n)); }
+    void hit() { hits.add(); }
+    void missed() { misses.add(); }
+    void waited(const timer &t) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t.start).count();
+        wait.record(static_cast<std::uint64_t>(ns));
+        max_wait_ns.record(ns);
+    }
+};
+#endif // METRICS_H_
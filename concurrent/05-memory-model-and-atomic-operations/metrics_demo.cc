@@ -0,0 +1,100 @@
+#include "metrics.h"
+#include "threadsafe-queue.h"
+#include "threadsafe_stack.h"
+#include "unordered_map.h"
+#include <cassert>
+#include <chrono>
+#include <exception>
+#include <thread>
+#include <vector>
+
+int main() {
+    striped_counter requests(4);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 8; t++) {
+        workers.emplace_back([&] {
+            for (int i = 0; i < 100000; i++) {
+                requests.add();
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    assert(requests.value() == 800000);
+    const auto drained = requests.exchange_zero();
+    assert(drained == 800000 && requests.value() == 0);
+
+    max_gauge high;
+    min_gauge low;
+    assert(high.empty() && low.empty());
+    for (int v : {3, -7, 12, 5}) {
+        high.record(v);
+        low.record(v);
+    }
+    assert(high.value() == 12 && low.value() == -7);
+    const auto highest = high.reset();
+    assert(highest == 12 && high.empty());
+
+    latency_histogram h(2);
+    for (std::uint64_t ns = 1; ns <= 1000; ns++) {
+        h.record(ns);
+    }
+    h.record(std::chrono::microseconds(50));
+    // every value lands in a bucket whose bounds hold it
+    for (std::uint64_t ns : {0ull, 1ull, 5ull, 999ull, 1ull << 40, ~0ull}) {
+        const auto i = latency_histogram::bucket_of(ns);
+        assert(latency_histogram::lower_bound(i) <= ns && ns <= latency_histogram::upper_bound(i));
+    }
+    const auto p50 = h.percentile(0.5), max = h.percentile(1.0);
+    assert(p50 >= 500 && p50 < 500 * 5 / 4 && max >= 50000);
+
+    // the same counters, behind the containers' Metrics hooks
+    ThreadsafeQueue<int, std::mutex, container_metrics> q;
+    int v;
+    const bool popped_from_empty = q.try_pop(v);
+    assert(!popped_from_empty);
+    std::thread consumer([&] {
+        const int first = q.wait_and_pop_value();
+        assert(first == 1);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    q.push(1);
+    consumer.join();
+    const std::vector<int> batch = {2, 3, 4};
+    q.push_bulk(batch.begin(), batch.end());
+    const bool popped = q.try_pop(v);
+    assert(popped && v == 2);
+    const auto &qm = q.metrics();
+    assert(qm.adds.value() == 4 && qm.removes.value() == 2 && qm.misses.value() == 1);
+    // the consumer was asleep for about the 20ms before the push
+    assert(qm.wait.percentile(1.0) >= 10000000 && qm.max_wait_ns.value() >= 10000000);
+
+    threadsafe_stack<int, std::mutex, container_metrics> s;
+    s.push(1);
+    s.pop(&v);
+    try {
+        s.pop();
+        assert(false);
+    } catch (const std::exception &) {
+    }
+    assert(s.metrics().adds.value() == 1 && s.metrics().removes.value() == 1 &&
+           s.metrics().misses.value() == 1);
+
+    ConcurrentHashMap<int, int, std::hash<int>, std::shared_mutex, container_metrics> m;
+    m.set(1, 1);
+    m.set(1, 2);
+    m.try_emplace(2, 2);
+    const auto one = m.get(1), three = m.get(3);
+    const bool visited = m.visit(2, [](int) {});
+    assert(*one == 2 && !three && visited);
+    const bool erased = m.compute_if_present(2, [](int &) { return false; });
+    const auto gone = m.remove(2);
+    assert(erased && !gone);
+    const auto removed = m.remove(1);
+    assert(removed && *removed == 2);
+    const auto &mm = m.metrics();
+    assert(mm.adds.value() == 2 && mm.removes.value() == 2);
+    assert(mm.hits.value() == 3 && mm.misses.value() == 2);
+    return 0;
+}
@@ -0,0 +1,125 @@
+#ifndef SEQ_ATOMIC_H_
+#define SEQ_ATOMIC_H_
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+// Atomic cell for trivially copyable T of any size, for values written
+// rarely and read often (config and routing snapshots). libstdc++ backs
+// std::atomic<T> wider than 16 bytes with a hidden lock, so every reader
+// writes shared memory; here readers only ever load.
+//
+// A seqlock: the version is odd while a write is in progress. A writer
+// makes it odd, copies the value in, and makes it even again; a reader
+// copies the value out between two loads of the version and retries if
+// they differ or were odd. Writers serialize on Mutex, which readers never
+// touch. The value is held as relaxed atomic words, so a reader's copy
+// racing with a write is a torn read it throws away, not a data race.
+//
+// The orders passed to load and store can only strengthen them: the
+// protocol needs a load to acquire and a store to release, so those are
+// the floor. seq_cst puts the version accesses in the single total order.
+template<typename T, typename Mutex = std::mutex>
+class SeqAtomic {
+    static_assert(std::is_trivially_copyable_v<T>, "SeqAtomic copies T bytewise");
+    static_assert(std::is_default_constructible_v<T>, "loads copy into a default-constructed T");
+private:
+    static constexpr std::size_t cache_line = 64;
+    using word = std::uint64_t;
+    static constexpr std::size_t words = (sizeof(T) + sizeof(word) - 1) / sizeof(word);
+
+    // the version shares the readers' lines; the writers' lock does not
+    alignas(cache_line) std::atomic<std::uint64_t> seq{0};
+    std::atomic<word> data[words];
+    alignas(cache_line) Mutex m_;
+
+    void write(const T &v, std::memory_order order) {
+        word buf[words] = {};
+        std::memcpy(buf, &v, sizeof(T));
+        const std::uint64_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        // keeps the odd version ahead of every word below
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < words; i++) {
+            data[i].store(buf[i], std::memory_order_relaxed);
+        }
+        seq.store(s + 2, order == std::memory_order_seq_cst ? order : std::memory_order_release);
+    };
+    // only valid under m_, when no write can interleave
+    T read_locked() const {
+        word buf[words];
+        for (std::size_t i = 0; i < words; i++) {
+            buf[i] = data[i].load(std::memory_order_relaxed);
+        }
+        T out;
+        std::memcpy(&out, buf, sizeof(T));
+        return out;
+    };
+
+public:
+    SeqAtomic() : SeqAtomic(T{}) {};
+    explicit SeqAtomic(const T &v) {
+        word buf[words] = {};
+        std::memcpy(buf, &v, sizeof(T));
+        for (std::size_t i = 0; i < words; i++) {
+            data[i].store(buf[i], std::memory_order_relaxed);
+        }
+    };
+    SeqAtomic(const SeqAtomic &) = delete;
+    SeqAtomic &operator=(const SeqAtomic &) = delete;
+
+    // Never blocks and never writes shared memory; spins only while a
+    // write is in progress, yielding if that write is slow to finish.
+    T load(std::memory_order order = std::memory_order_seq_cst) const {
+        const auto first = order == std::memory_order_seq_cst ? order : std::memory_order_acquire;
+        word buf[words];
+        for (unsigned spins = 0;; spins++) {
+            const std::uint64_t s0 = seq.load(first);
+            if (!(s0 & 1)) {
+                for (std::size_t i = 0; i < words; i++) {
+                    buf[i] = data[i].load(std::memory_order_relaxed);
+                }
+                // keeps the words above ahead of the version recheck
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq.load(std::memory_order_relaxed) == s0) {
+                    break;
+                }
+            }
+            if (spins >= 64) {
+                std::this_thread::yield();
+            }
+        }
+        T out;
+        std::memcpy(&out, buf, sizeof(T));
+        return out;
+    };
+    void store(const T &v, std::memory_order order = std::memory_order_seq_cst) {
+        std::lock_guard<Mutex> lk(m_);
+        write(v, order);
+    };
+    // stores f(current value) as one write; returns what was stored
+    template<typename F>
+    T update(F &&f, std::memory_order order = std::memory_order_seq_cst) {
+        std::lock_guard<Mutex> lk(m_);
+        const T next = f(read_locked());
+        write(next, order);
+        return next;
+    };
+
+    // Even, and bumped by 2 on every store. A poller can compare it with
+    // the last version it copied and skip the copy when nothing changed.
+    std::uint64_t version(std::memory_order order = std::memory_order_acquire) const {
+        return seq.load(order) & ~std::uint64_t(1);
+    };
+
+    operator T() const { return load(); };
+    T operator=(const T &v) {
+        store(v);
+        return v;
+    };
+};
+#endif // SEQ_ATOMIC_H_
@@ -0,0 +1,65 @@
+#include "seq_atomic.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Readers poll a 64-byte snapshot while one writer replaces it every
+// 100us: SeqAtomic against libstdc++'s lock-backed std::atomic<T>.
+// Reported in loads per second across all readers.
+
+using Clock = std::chrono::steady_clock;
+
+struct Snapshot {
+    std::uint64_t v[8];
+};
+
+template<typename Cell>
+double run(unsigned readers) {
+    Cell cell(Snapshot{});
+    std::atomic<bool> done{false};
+    std::atomic<std::uint64_t> loads{0};
+    std::thread writer([&] {
+        for (std::uint64_t n = 1; !done.load(std::memory_order_relaxed); n++) {
+            Snapshot s;
+            for (auto &x : s.v) {
+                x = n;
+            }
+            cell.store(s, std::memory_order_release);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+    const auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < readers; t++) {
+        workers.emplace_back([&] {
+            std::uint64_t n = 0, sink = 0;
+            while (Clock::now() - start < std::chrono::milliseconds(500)) {
+                for (int i = 0; i < 256; i++, n++) {
+                    sink += cell.load(std::memory_order_acquire).v[0];
+                }
+            }
+            loads.fetch_add(n + (sink == 0), std::memory_order_relaxed);
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    const double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    done = true;
+    writer.join();
+    return loads.load() / secs;
+}
+
+int main() {
+    const unsigned max_readers = std::max(4u, std::thread::hardware_concurrency());
+    std::printf("%-8s %16s %16s\n", "readers", "std::atomic", "SeqAtomic");
+    for (unsigned readers = 1; readers <= max_readers; readers *= 2) {
+        const double a = run<std::atomic<Snapshot>>(readers);
+        const double b = run<SeqAtomic<Snapshot>>(readers);
+        std::printf("%-8u %16.3e %16.3e\n", readers, a, b);
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "seq_atomic.h"
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// a routing snapshot: every field of one version holds the same number,
+// so a reader can tell a torn copy from a whole one
+struct Routes {
+    std::uint64_t epoch;
+    std::uint32_t shard_of[16];
+    char name[13];
+};
+
+static Routes make(std::uint64_t n) {
+    Routes r{};
+    r.epoch = n;
+    for (auto &s : r.shard_of) {
+        s = static_cast<std::uint32_t>(n);
+    }
+    for (auto &c : r.name) {
+        c = static_cast<char>(n);
+    }
+    return r;
+}
+
+static bool whole(const Routes &r) {
+    for (auto s : r.shard_of) {
+        if (s != static_cast<std::uint32_t>(r.epoch)) {
+            return false;
+        }
+    }
+    for (auto c : r.name) {
+        if (c != static_cast<char>(r.epoch)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    SeqAtomic<Routes> routes(make(0));
+    assert(routes.version() == 0 && routes.load().epoch == 0);
+    routes.store(make(1), std::memory_order_release);
+    assert(routes.version() == 2 && whole(routes.load(std::memory_order_acquire)));
+
+    const int writers = 2, per_writer = 20000, readers = 4;
+    std::atomic<bool> done{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < readers; t++) {
+        threads.emplace_back([&] {
+            std::uint64_t seen = 0, last_epoch = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                if (routes.version() == seen) {
+                    continue;
+                }
+                seen = routes.version();
+                const Routes r = routes.load(std::memory_order_acquire);
+                assert(whole(r) && r.epoch >= last_epoch);
+                last_epoch = r.epoch;
+            }
+        });
+    }
+    std::vector<std::thread> updaters;
+    for (int t = 0; t < writers; t++) {
+        updaters.emplace_back([&] {
+            for (int i = 0; i < per_writer; i++) {
+                routes.update([](const Routes &r) { return make(r.epoch + 1); });
+            }
+        });
+    }
+    for (auto &u : updaters) {
+        u.join();
+    }
+    done = true;
+    for (auto &t : threads) {
+        t.join();
+    }
+    // update is read-modify-write under the writer lock, so none is lost
+    const Routes last = routes;
+    assert(last.epoch == 1 + writers * per_writer && whole(last));
+    assert(routes.version() == 2 * (last.epoch));
+    return 0;
+}
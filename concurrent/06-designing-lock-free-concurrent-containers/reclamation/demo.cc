@@ -0,0 +1,82 @@
+#include "reclaim.h"
+#include <atomic>
+#include <cassert>
+#include <stdexcept>
+#include <thread>
+
+struct Tracked {
+    static std::atomic<int> alive;
+    Tracked() { alive++; };
+    ~Tracked() { alive--; };
+};
+std::atomic<int> Tracked::alive{0};
+
+int main() {
+    // a protected node survives a scan, an unprotected one does not
+    std::atomic<Tracked *> shared{new Tracked};
+    {
+        HazardGuard<2> guard;
+        Tracked *p = guard.protect(0, shared);
+        shared.store(new Tracked);
+        HazardReclaim::retire(p);
+        HazardReclaim::synchronize();
+        assert(Tracked::alive == 2 && HazardReclaim::pending() == 1);
+        guard.reset(0);
+        HazardReclaim::synchronize();
+        assert(Tracked::alive == 1 && HazardReclaim::pending() == 0);
+    }
+
+    // a node retired while another thread is pinned outlives the pin
+    std::atomic<int> stage{0};
+    std::thread reader([&] {
+        EpochReclaim::Guard guard;
+        Tracked *p = guard.protect(0, shared);
+        stage = 1;
+        while (stage != 2) {
+            std::this_thread::yield();
+        }
+        assert(p && Tracked::alive == 1);
+    });
+    while (stage != 1) {
+        std::this_thread::yield();
+    }
+    EpochReclaim::retire(shared.exchange(nullptr));
+    EpochReclaim::synchronize();
+    assert(Tracked::alive == 1);
+    stage = 2;
+    reader.join();
+    EpochReclaim::synchronize();
+    assert(Tracked::alive == 0 && EpochReclaim::pending() == 0);
+
+    // guards nest: each takes its own slots
+    std::atomic<Tracked *> a{new Tracked}, b{new Tracked};
+    {
+        HazardGuard<1> outer;
+        Tracked *pa = outer.protect(0, a);
+        {
+            HazardGuard<2> inner;
+            inner.protect(0, b);
+        }
+        HazardReclaim::retire(a.exchange(nullptr));
+        HazardReclaim::retire(b.exchange(nullptr));
+        HazardReclaim::synchronize();
+        assert(Tracked::alive == 1 && pa);
+    }
+    HazardReclaim::synchronize();
+    assert(Tracked::alive == 0);
+
+    // more live slots than a thread has is an error in any build
+    {
+        HazardGuard<3> most;
+        bool threw = false;
+        try {
+            HazardGuard<2> one_too_many;
+        } catch (const std::out_of_range &) {
+            threw = true;
+        }
+        assert(threw);
+    }
+    // the failed guard took nothing, so all the slots are free again
+    HazardGuard<HazardDomain::slots_per_thread> all;
+    return 0;
+}
@@ -0,0 +1,185 @@
+#ifndef EPOCH_H_
+#define EPOCH_H_
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Epoch-based reclamation. A reader pins the global epoch for as long as it
+// holds an EpochGuard; a writer retires nodes it has unlinked, tagged with
+// the epoch at retire time. The global epoch only advances once every
+// pinned thread has observed it, so a node retired two epochs ago can no
+// longer be reachable by any reader and is freed.
+class EpochDomain {
+private:
+    struct Retired {
+        void *p;
+        void (*deleter)(void *);
+        std::uint64_t epoch;
+    };
+    static constexpr std::size_t retire_batch = 64;
+
+    struct alignas(64) Record {
+        // (epoch << 1) | 1 while pinned, 0 while quiescent
+        std::atomic<std::uint64_t> state{0};
+        std::atomic<bool> in_use{true};
+        Record *next = nullptr;
+        // owned by the thread holding the record
+        unsigned nesting = 0;
+        std::vector<Retired> retired;
+        std::size_t collect_at = retire_batch;
+    };
+    struct ThreadHandle {
+        Record *rec = nullptr;
+        ~ThreadHandle() {
+            if (rec) {
+                instance().release(rec);
+            }
+        };
+    };
+
+    alignas(64) std::atomic<std::uint64_t> global_epoch{1};
+    std::atomic<Record *> records{nullptr};
+    std::mutex orphan_m_;
+    std::vector<Retired> orphans;
+
+    EpochDomain() = default;
+
+    Record *acquire_record() {
+        for (Record *r = records.load(std::memory_order_acquire); r; r = r->next) {
+            bool expected = false;
+            if (!r->in_use.load(std::memory_order_relaxed) &&
+                r->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return r;
+            }
+        }
+        Record *r = new Record;
+        r->next = records.load(std::memory_order_relaxed);
+        while (!records.compare_exchange_weak(r->next, r, std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+        }
+        return r;
+    };
+
+    // a thread that exits hands its pending nodes to whoever collects next
+    void release(Record *r) {
+        collect(r->retired);
+        if (!r->retired.empty()) {
+            std::lock_guard<std::mutex> lk(orphan_m_);
+            orphans.insert(orphans.end(), r->retired.begin(), r->retired.end());
+        }
+        r->retired.clear();
+        r->collect_at = retire_batch;
+        r->state.store(0, std::memory_order_release);
+        r->in_use.store(false, std::memory_order_release);
+    };
+
+    static Record *local_record() {
+        thread_local ThreadHandle handle;
+        if (!handle.rec) {
+            handle.rec = instance().acquire_record();
+        }
+        return handle.rec;
+    };
+
+    bool try_advance() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::uint64_t e = global_epoch.load(std::memory_order_relaxed);
+        for (Record *r = records.load(std::memory_order_acquire); r; r = r->next) {
+            std::uint64_t s = r->state.load(std::memory_order_acquire);
+            if ((s & 1) && (s >> 1) != e) {
+                return false;
+            }
+        }
+        return global_epoch.compare_exchange_strong(e, e + 1, std::memory_order_acq_rel);
+    };
+
+    void collect(std::vector<Retired> &list) {
+        const std::uint64_t e = global_epoch.load(std::memory_order_acquire);
+        auto keep = list.begin();
+        for (auto it = list.begin(); it != list.end(); ++it) {
+            if (it->epoch + 2 <= e) {
+                it->deleter(it->p);
+            } else {
+                *keep++ = *it;
+            }
+        }
+        list.erase(keep, list.end());
+    };
+
+    void collect_orphans() {
+        std::unique_lock<std::mutex> lk(orphan_m_, std::try_to_lock);
+        if (lk.owns_lock() && !orphans.empty()) {
+            collect(orphans);
+        }
+    };
+
+public:
+    EpochDomain(const EpochDomain &) = delete;
+    EpochDomain &operator=(const EpochDomain &) = delete;
+
+    // never destroyed: thread-exit handlers may still run after main returns
+    static EpochDomain &instance() {
+        static EpochDomain *domain = new EpochDomain;
+        return *domain;
+    };
+
+    void enter() {
+        Record *r = local_record();
+        if (r->nesting++ == 0) {
+            r->state.store((global_epoch.load(std::memory_order_relaxed) << 1) | 1,
+                           std::memory_order_relaxed);
+            // the pin must be visible before any shared pointer is read
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    };
+    void exit() {
+        Record *r = local_record();
+        if (--r->nesting == 0) {
+            r->state.store(0, std::memory_order_release);
+        }
+    };
+
+    void retire(void *p, void (*deleter)(void *)) {
+        Record *r = local_record();
+        r->retired.push_back({p, deleter, global_epoch.load(std::memory_order_acquire)});
+        if (r->retired.size() >= r->collect_at) {
+            try_advance();
+            collect(r->retired);
+            collect_orphans();
+            // while a reader holds the epoch back most of the list survives;
+            // growing the threshold keeps rescans amortized O(1) per retire
+            r->collect_at = r->retired.size() + std::max(retire_batch, r->retired.size() / 2);
+        }
+    };
+    template<typename T>
+    void retire(T *p) {
+        retire(p, [](void *q) { delete static_cast<T *>(q); });
+    };
+
+    // advances as far as current readers allow and frees this thread's
+    // eligible nodes; a quiescent caller with no other pinned threads ends
+    // up freeing everything it retired
+    void synchronize() {
+        for (int i = 0; i < 3 && try_advance(); i++) {
+        }
+        collect(local_record()->retired);
+        collect_orphans();
+    };
+
+    std::size_t pending() {
+        return local_record()->retired.size();
+    };
+};
+
+class EpochGuard {
+public:
+    EpochGuard() { EpochDomain::instance().enter(); };
+    EpochGuard(const EpochGuard &) = delete;
+    EpochGuard &operator=(const EpochGuard &) = delete;
+    ~EpochGuard() { EpochDomain::instance().exit(); };
+};
+#endif // EPOCH_H_
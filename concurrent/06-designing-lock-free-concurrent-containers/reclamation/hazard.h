@@ -0,0 +1,219 @@
+#ifndef HAZARD_H_
+#define HAZARD_H_
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+// Hazard pointers (Michael, 2004). Before dereferencing a shared pointer a
+// reader publishes it in one of its hazard slots and re-reads the source to
+// confirm it is still reachable. A retired node is only freed by a scan that
+// finds it in no slot. Unlike epochs, a stalled reader pins at most the
+// handful of nodes it has published, so memory held stays bounded; the
+// price is a store-load fence on every protect.
+class HazardDomain {
+public:
+    static constexpr std::size_t slots_per_thread = 4;
+
+private:
+    struct Retired {
+        void *p;
+        void (*deleter)(void *);
+    };
+    struct alignas(64) Record {
+        std::atomic<void *> hazards[slots_per_thread] = {};
+        std::atomic<bool> in_use{true};
+        Record *next = nullptr;
+        // owned by the thread holding the record
+        std::size_t used = 0;
+        std::vector<Retired> retired;
+    };
+    struct ThreadHandle {
+        Record *rec = nullptr;
+        ~ThreadHandle() {
+            if (rec) {
+                instance().release(rec);
+            }
+        };
+    };
+
+    static constexpr std::size_t retire_batch = 64;
+
+    std::atomic<Record *> records{nullptr};
+    std::atomic<std::size_t> num_records{0};
+    std::mutex orphan_m_;
+    std::vector<Retired> orphans;
+
+    HazardDomain() = default;
+
+    Record *acquire_record() {
+        for (Record *r = records.load(std::memory_order_acquire); r; r = r->next) {
+            bool expected = false;
+            if (!r->in_use.load(std::memory_order_relaxed) &&
+                r->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return r;
+            }
+        }
+        Record *r = new Record;
+        r->next = records.load(std::memory_order_relaxed);
+        while (!records.compare_exchange_weak(r->next, r, std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+        }
+        num_records.fetch_add(1, std::memory_order_relaxed);
+        return r;
+    };
+
+    void release(Record *r) {
+        for (auto &h : r->hazards) {
+            h.store(nullptr, std::memory_order_release);
+        }
+        scan(r->retired);
+        if (!r->retired.empty()) {
+            std::lock_guard<std::mutex> lk(orphan_m_);
+            orphans.insert(orphans.end(), r->retired.begin(), r->retired.end());
+        }
+        r->retired.clear();
+        r->used = 0;
+        r->in_use.store(false, std::memory_order_release);
+    };
+
+    static Record *local_record() {
+        thread_local ThreadHandle handle;
+        if (!handle.rec) {
+            handle.rec = instance().acquire_record();
+        }
+        return handle.rec;
+    };
+
+    // frees every node in list that no hazard slot currently names
+    void scan(std::vector<Retired> &list) {
+        if (list.empty()) {
+            return;
+        }
+        // Unlinks may be acquire-only CASes, which do not order the slot
+        // loads below after them; without this store-load fence a reader
+        // that published its hazard just before the unlink could be missed.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::vector<void *> hazards;
+        hazards.reserve(num_records.load(std::memory_order_relaxed) * slots_per_thread);
+        for (Record *r = records.load(std::memory_order_acquire); r; r = r->next) {
+            for (auto &h : r->hazards) {
+                if (void *p = h.load(std::memory_order_seq_cst)) {
+                    hazards.push_back(p);
+                }
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+        auto keep = list.begin();
+        for (auto it = list.begin(); it != list.end(); ++it) {
+            if (std::binary_search(hazards.begin(), hazards.end(), it->p)) {
+                *keep++ = *it;
+            } else {
+                it->deleter(it->p);
+            }
+        }
+        list.erase(keep, list.end());
+    };
+
+    void scan_orphans() {
+        std::unique_lock<std::mutex> lk(orphan_m_, std::try_to_lock);
+        if (lk.owns_lock() && !orphans.empty()) {
+            scan(orphans);
+        }
+    };
+
+public:
+    HazardDomain(const HazardDomain &) = delete;
+    HazardDomain &operator=(const HazardDomain &) = delete;
+
+    // never destroyed: thread-exit handlers may still run after main returns
+    static HazardDomain &instance() {
+        static HazardDomain *domain = new HazardDomain;
+        return *domain;
+    };
+
+    // hands out n consecutive slots of the calling thread's record;
+    // released in LIFO order by release_slots. Running out means too many
+    // guards are live on this thread at once, which release builds must not
+    // paper over either.
+    std::atomic<void *> *acquire_slots(std::size_t n) {
+        Record *r = local_record();
+        if (r->used + n > slots_per_thread) {
+            throw std::out_of_range("too many live hazard pointers on this thread");
+        }
+        std::atomic<void *> *slots = &r->hazards[r->used];
+        r->used += n;
+        return slots;
+    };
+    void release_slots(std::atomic<void *> *slots, std::size_t n) {
+        Record *r = local_record();
+        for (std::size_t i = 0; i < n; i++) {
+            slots[i].store(nullptr, std::memory_order_release);
+        }
+        r->used -= n;
+    };
+
+    // publishes src in slot and returns it once it is known to still be
+    // reachable; the result stays valid until the slot is overwritten
+    template<typename T>
+    static T *protect(std::atomic<void *> &slot, const std::atomic<T *> &src) {
+        T *p = src.load(std::memory_order_relaxed);
+        for (;;) {
+            slot.store(p, std::memory_order_seq_cst);
+            T *q = src.load(std::memory_order_seq_cst);
+            if (q == p) {
+                return p;
+            }
+            p = q;
+        }
+    };
+
+    void retire(void *p, void (*deleter)(void *)) {
+        Record *r = local_record();
+        r->retired.push_back({p, deleter});
+        // amortize the scan: at most slots_per_thread * records nodes can
+        // survive it, so waiting for twice that frees at least half
+        const std::size_t threshold = std::max(
+            retire_batch, 2 * slots_per_thread * num_records.load(std::memory_order_relaxed));
+        if (r->retired.size() >= threshold) {
+            scan(r->retired);
+            scan_orphans();
+        }
+    };
+    template<typename T>
+    void retire(T *p) {
+        retire(p, [](void *q) { delete static_cast<T *>(q); });
+    };
+
+    // frees this thread's retired nodes that are not currently protected
+    void synchronize() {
+        scan(local_record()->retired);
+        scan_orphans();
+    };
+
+    std::size_t pending() {
+        return local_record()->retired.size();
+    };
+};
+
+// owns Slots hazard pointers of the calling thread for its lifetime
+template<std::size_t Slots = 1>
+class HazardGuard {
+private:
+    std::atomic<void *> *slots;
+
+public:
+    HazardGuard() : slots(HazardDomain::instance().acquire_slots(Slots)) {};
+    HazardGuard(const HazardGuard &) = delete;
+    HazardGuard &operator=(const HazardGuard &) = delete;
+    ~HazardGuard() { HazardDomain::instance().release_slots(slots, Slots); };
+
+    template<typename T>
+    T *protect(std::size_t i, const std::atomic<T *> &src) {
+        return HazardDomain::protect(slots[i], src);
+    };
+    void reset(std::size_t i) { slots[i].store(nullptr, std::memory_order_release); };
+};
+#endif // HAZARD_H_
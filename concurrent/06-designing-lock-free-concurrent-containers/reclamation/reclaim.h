@@ -0,0 +1,51 @@
+#ifndef RECLAIM_H_
+#define RECLAIM_H_
+#include <atomic>
+#include <cstddef>
+#include "epoch.h"
+#include "hazard.h"
+
+// Reclamation policies a lock-free container is parameterized on. Both
+// expose the same surface, so the container is written once:
+//
+//     typename Reclaim::Guard guard;          // per operation
+//     Node *n = guard.protect(0, head);       // safe to dereference
+//     ...unlink n...
+//     Reclaim::retire(n);                     // freed once unreachable
+//
+// Guard slots are indexed from 0 to Reclaim::slots - 1.
+
+// Cheapest reads: protect is a plain acquire load and the guard costs one
+// fence per operation. A reader that stalls inside a guard holds back
+// every node retired after it.
+struct EpochReclaim {
+    static constexpr std::size_t slots = static_cast<std::size_t>(-1);
+    class Guard {
+    private:
+        EpochGuard pin;
+
+    public:
+        template<typename T>
+        T *protect(std::size_t, const std::atomic<T *> &src) {
+            return src.load(std::memory_order_acquire);
+        };
+        void reset(std::size_t) {};
+    };
+    template<typename T>
+    static void retire(T *p) { EpochDomain::instance().retire(p); };
+    static void synchronize() { EpochDomain::instance().synchronize(); };
+    static std::size_t pending() { return EpochDomain::instance().pending(); };
+};
+
+// Bounded garbage: a stalled reader only holds the nodes it has published.
+// Each protect costs a store-load fence, and traversals must protect every
+// node they step through.
+struct HazardReclaim {
+    static constexpr std::size_t slots = 2;
+    using Guard = HazardGuard<slots>;
+    template<typename T>
+    static void retire(T *p) { HazardDomain::instance().retire(p); };
+    static void synchronize() { HazardDomain::instance().synchronize(); };
+    static std::size_t pending() { return HazardDomain::instance().pending(); };
+};
+#endif // RECLAIM_H_
@@ -0,0 +1,117 @@
+#include "lock-free-stack.h"
+#include "threadsafe_stack.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Retire-heavy workload: every thread alternates push and pop on one
+// stack, so every pop retires a node. For each reclamation policy this
+// reports throughput and the peak number of retired-but-not-freed nodes
+// (summed over threads), first with all threads running and then with an
+// extra reader that takes a guard and stalls inside it for the whole
+// run. threadsafe_stack frees on pop and is the reclamation-free baseline.
+
+using Clock = std::chrono::steady_clock;
+constexpr auto run_for = std::chrono::milliseconds(200);
+
+struct Result {
+    double ops_per_sec;
+    std::size_t peak_pending;
+};
+
+template<typename Work>
+Result run(unsigned threads, Work &&work) {
+    std::atomic<bool> stop{false};
+    std::atomic<unsigned long> total{0};
+    std::atomic<std::size_t> peak{0};
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            unsigned long ops = 0;
+            std::size_t my_peak = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 256; i++) {
+                    my_peak = std::max(my_peak, work(ops++));
+                }
+            }
+            total += ops;
+            peak += my_peak;
+        });
+    }
+    std::this_thread::sleep_for(run_for);
+    stop = true;
+    for (auto &w : workers) {
+        w.join();
+    }
+    return {total / std::chrono::duration<double>(run_for).count(), peak.load()};
+}
+
+template<typename Reclaim>
+Result lock_free(unsigned threads, bool stalled_reader) {
+    LockFreeStack<int, Reclaim> stack;
+    for (int i = 0; i < 1024; i++) {
+        stack.push(i);
+    }
+    std::atomic<bool> release{false}, pinned{false};
+    std::thread reader;
+    if (stalled_reader) {
+        reader = std::thread([&] {
+            typename Reclaim::Guard guard;
+            // like a pop preempted inside its guard
+            pinned = true;
+            while (!release) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+        while (!pinned) {
+            std::this_thread::yield();
+        }
+    }
+    auto r = run(threads, [&](unsigned long op) -> std::size_t {
+        int v;
+        stack.push(static_cast<int>(op));
+        stack.try_pop(v);
+        return op % 64 == 0 ? Reclaim::pending() : 0;
+    });
+    release = true;
+    if (reader.joinable()) {
+        reader.join();
+    }
+    return r;
+}
+
+Result locked(unsigned threads) {
+    threadsafe_stack<int> stack;
+    for (int i = 0; i < 1024; i++) {
+        stack.push(i);
+    }
+    return run(threads, [&](unsigned long op) -> std::size_t {
+        int v;
+        stack.push(static_cast<int>(op));
+        stack.pop(&v);
+        return 0;
+    });
+}
+
+int main(int argc, char *argv[]) {
+    unsigned max_threads = argc > 1 ? std::atoi(argv[1]) : 2 * std::thread::hardware_concurrency();
+    std::printf("%8s %12s %12s %10s %12s %10s %12s %12s\n", "threads", "mutex ops/s",
+                "epoch ops/s", "held", "hazard ops/s", "held", "epoch held*", "hazard held*");
+    for (unsigned threads = 1; threads <= std::max(1u, max_threads); threads *= 2) {
+        Result mutex = locked(threads);
+        Result epoch = lock_free<EpochReclaim>(threads, false);
+        Result hazard = lock_free<HazardReclaim>(threads, false);
+        Result epoch_stalled = lock_free<EpochReclaim>(threads, true);
+        Result hazard_stalled = lock_free<HazardReclaim>(threads, true);
+        std::printf("%8u %12.3e %12.3e %10zu %12.3e %10zu %12zu %12zu\n", threads,
+                    mutex.ops_per_sec, epoch.ops_per_sec, epoch.peak_pending,
+                    hazard.ops_per_sec, hazard.peak_pending, epoch_stalled.peak_pending,
+                    hazard_stalled.peak_pending);
+    }
+    std::printf("* with one reader stalled inside a guard\n");
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "skip-list-map.h"
+#include "unordered_map.h"
+#include <atomic>
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+
+// written once against the shared surface, run on either map
+template<typename Map>
+void word_counts() {
+    Map m;
+    const std::vector<std::string> words = {"b", "a", "c", "a", "b", "a"};
+    for (auto &w : words) {
+        auto n = m.get(w);
+        m.set(w, n ? *n + 1 : 1);
+    }
+    assert(m.size() == 3 && *m.get("a") == 3 && *m.get("b") == 2);
+    const auto removed = m.remove("c");
+    const auto again = m.remove("c");
+    assert(removed && *removed == 1 && !again && !m.get("c"));
+}
+
+// writers churn the odd keys while the even ones stay put; every scan must
+// be ascending and see each even key exactly once
+static void concurrent_scans() {
+    ConcurrentSkipListMap<int, int> m;
+    const int keys = 2000, writers = 3, rounds = 20000;
+    for (int k = 0; k < keys; k += 2) {
+        m.set(k, k);
+    }
+    std::atomic<bool> done{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < writers; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < rounds; i++) {
+                const int k = static_cast<int>((i * 7919u + t * 104729u) % keys) | 1;
+                if (i % 2) {
+                    m.remove(k);
+                } else {
+                    m.set(k, k);
+                }
+            }
+        });
+    }
+    threads.emplace_back([&] {
+        while (!done.load()) {
+            int last = -1, evens = 0;
+            m.for_each([&](int k, int v) {
+                assert(k > last && k == v);
+                last = k;
+                evens += k % 2 == 0;
+            });
+            assert(evens == keys / 2);
+            evens = 0;
+            m.range(500, 1000, [&](int k, int) {
+                assert(k >= 500 && k < 1000);
+                evens += k % 2 == 0;
+            });
+            assert(evens == 250);
+            auto lb = m.lower_bound(1001);
+            assert(lb && lb->first >= 1001 && lb->first <= 1002);
+        }
+    });
+    for (int t = 0; t < writers; t++) {
+        threads[t].join();
+    }
+    done = true;
+    threads.back().join();
+
+    // settle the odd keys and check the count agrees with a scan
+    for (int k = 1; k < keys; k += 2) {
+        m.remove(k);
+    }
+    std::size_t n = 0;
+    m.for_each([&](int, int) { n++; });
+    assert(n == m.size() && n == keys / 2);
+}
+
+int main() {
+    ConcurrentSkipListMap<int, std::string> m;
+    assert(m.empty() && !m.get(1) && !m.lower_bound(0));
+    m.set(3, "three");
+    m.set(1, "one");
+    m.set(2, "two");
+    m.set(2, "deux");
+    assert(m.size() == 3 && *m.get(2) == "deux");
+    assert(m.lower_bound(2)->second == "deux" && m.lower_bound(4) == std::nullopt);
+
+    std::string seen;
+    m.for_each([&](int, const std::string &v) { seen += v[0]; });
+    assert(seen == "odt");
+    seen.clear();
+    // returning false stops the scan
+    m.range(1, 3, [&](int, const std::string &v) {
+        seen += v[0];
+        return false;
+    });
+    assert(seen == "o");
+    assert(m.visit(3, [](const std::string &v) { assert(v == "three"); }));
+    const auto one = m.remove(1);
+    assert(one && *one == "one" && m.lower_bound(0)->first == 2);
+
+    word_counts<ConcurrentHashMap<std::string, int>>();
+    word_counts<ConcurrentSkipListMap<std::string, int>>();
+
+    concurrent_scans();
+    return 0;
+}
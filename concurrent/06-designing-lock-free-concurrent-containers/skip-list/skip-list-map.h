@@ -0,0 +1,327 @@
+#ifndef SKIP_LIST_MAP_H_
+#define SKIP_LIST_MAP_H_
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "reclaim.h"
+
+// Ordered counterpart of ConcurrentHashMap with the same get/set/remove
+// surface, plus lower_bound, range scans and ordered for_each.
+//
+// Lock-free skip list after Herlihy and Shavit, with Harris-style marked
+// next pointers. A node's value is a separately allocated V behind an
+// atomic pointer: set on an existing key swaps it, and remove swaps in
+// null, which is the linearization point. The remover then marks the
+// node's links top-down so traversals snip it out level by level.
+//
+// Both the inserting and the removing thread may still be linking or
+// unlinking upper levels when the other finishes, so each holds one
+// reference to the node and the last to let go retires it. Nodes and
+// values are freed through EpochReclaim, whose guards pin whole
+// traversals; hazard pointers would need a slot per level.
+template<typename K, typename V, typename Compare=std::less<K>>
+class ConcurrentSkipListMap {
+private:
+    static constexpr int max_level = 16;
+    using Link = std::atomic<std::uintptr_t>;
+
+    struct Node {
+        const K key;
+        std::atomic<V *> value;
+        const int height;
+        std::unique_ptr<Link[]> next;
+        // the inserter's and the remover's claims; the last one out retires
+        std::atomic<int> owners{2};
+
+        template<typename KK>
+        Node(KK &&key, V *value, int height)
+            : key(std::forward<KK>(key)), value(value), height(height), next(new Link[height]) {};
+        ~Node() { delete value.load(std::memory_order_relaxed); };
+    };
+
+    // the head is just a full-height column of links; a pred is identified
+    // by its link array, which lets the head stand in for a node
+    Link head[max_level];
+    std::atomic<std::size_t> count{0};
+    Compare less;
+
+    static Node *ptr(std::uintptr_t l) { return reinterpret_cast<Node *>(l & ~std::uintptr_t(1)); };
+    static bool marked(std::uintptr_t l) { return l & 1; };
+    static std::uintptr_t link(Node *n) { return reinterpret_cast<std::uintptr_t>(n); };
+
+    static int random_level() {
+        thread_local std::uint64_t state =
+            std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        // p = 1/4 per level
+        const std::uint64_t r = state | (std::uint64_t(1) << (2 * (max_level - 1)));
+        return __builtin_ctzll(r) / 2 + 1;
+    };
+
+    bool equal(const K &a, const K &b) const { return !less(a, b) && !less(b, a); };
+
+    // Fills preds/succs around key on every level, snipping marked nodes
+    // on the way; restarts from the top if a snip loses a race. True if
+    // succs[0] holds key. Only valid under an EpochReclaim guard.
+    bool find(const K &key, Link **preds, Node **succs) {
+    retry:
+        Link *pred = head;
+        for (int lvl = max_level - 1; lvl >= 0; --lvl) {
+            Node *curr = ptr(pred[lvl].load(std::memory_order_acquire));
+            while (curr) {
+                std::uintptr_t succ = curr->next[lvl].load(std::memory_order_acquire);
+                if (marked(succ)) {
+                    std::uintptr_t expected = link(curr);
+                    if (!pred[lvl].compare_exchange_strong(expected, succ & ~std::uintptr_t(1),
+                                                           std::memory_order_acq_rel,
+                                                           std::memory_order_acquire)) {
+                        goto retry;
+                    }
+                    curr = ptr(succ);
+                    continue;
+                }
+                if (!less(curr->key, key)) {
+                    break;
+                }
+                pred = curr->next.get();
+                curr = ptr(succ);
+            }
+            preds[lvl] = pred;
+            succs[lvl] = curr;
+        }
+        return succs[0] && equal(succs[0]->key, key);
+    };
+
+    // Read-only descent: steps over marked nodes instead of snipping them,
+    // so readers never write shared memory. Returns the first node on
+    // level 0 whose key is not less than key.
+    Node *seek(const K &key) const {
+        const Link *pred = head;
+        Node *curr = nullptr;
+        for (int lvl = max_level - 1; lvl >= 0; --lvl) {
+            curr = ptr(pred[lvl].load(std::memory_order_acquire));
+            while (curr) {
+                std::uintptr_t succ = curr->next[lvl].load(std::memory_order_acquire);
+                if (!marked(succ) && !less(curr->key, key)) {
+                    break;
+                }
+                if (!marked(succ)) {
+                    pred = curr->next.get();
+                }
+                curr = ptr(succ);
+            }
+        }
+        return curr;
+    };
+
+    // marks every level top-down; idempotent, so anyone may help
+    static void mark(Node *n) {
+        for (int lvl = n->height - 1; lvl >= 0; --lvl) {
+            std::uintptr_t l = n->next[lvl].load(std::memory_order_relaxed);
+            while (!marked(l) && !n->next[lvl].compare_exchange_weak(l, l | 1, std::memory_order_seq_cst,
+                                                                     std::memory_order_relaxed)) {
+            }
+        }
+    };
+
+    static void release(Node *n) {
+        if (n->owners.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            EpochReclaim::retire(n);
+        }
+    };
+
+    template<typename KK>
+    void insert(KK &&key, V *value) {
+        EpochReclaim::Guard guard;
+        Link *preds[max_level];
+        Node *succs[max_level];
+        Node *fresh = nullptr;
+        for (;;) {
+            // once fresh exists it owns the key, which may have been moved from
+            if (find(fresh ? fresh->key : key, preds, succs)) {
+                Node *n = succs[0];
+                V *cur = n->value.load(std::memory_order_acquire);
+                if (!cur) {
+                    // removed but not yet unlinked; help, then insert anew
+                    mark(n);
+                    continue;
+                }
+                if (n->value.compare_exchange_strong(cur, value, std::memory_order_acq_rel,
+                                                     std::memory_order_acquire)) {
+                    EpochReclaim::retire(cur);
+                    if (fresh) {
+                        fresh->value.store(nullptr, std::memory_order_relaxed);
+                        delete fresh;
+                    }
+                    return;
+                }
+                continue;
+            }
+            if (!fresh) {
+                fresh = new Node(std::forward<KK>(key), value, random_level());
+            }
+            for (int lvl = 0; lvl < fresh->height; lvl++) {
+                fresh->next[lvl].store(link(succs[lvl]), std::memory_order_relaxed);
+            }
+            std::uintptr_t expected = link(succs[0]);
+            if (preds[0][0].compare_exchange_strong(expected, link(fresh), std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        count.fetch_add(1, std::memory_order_relaxed);
+        for (int lvl = 1; lvl < fresh->height; lvl++) {
+            for (;;) {
+                std::uintptr_t l = fresh->next[lvl].load(std::memory_order_acquire);
+                // a remover got here first; stop linking
+                if (marked(l) || (l != link(succs[lvl]) &&
+                                  !fresh->next[lvl].compare_exchange_strong(l, link(succs[lvl])))) {
+                    goto linked;
+                }
+                std::uintptr_t expected = link(succs[lvl]);
+                if (preds[lvl][lvl].compare_exchange_strong(expected, link(fresh))) {
+                    break;
+                }
+                if (!find(fresh->key, preds, succs) || succs[0] != fresh) {
+                    goto linked;
+                }
+            }
+        }
+    linked:
+        // if a remover may have missed a level linked above, snip it here
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (marked(fresh->next[0].load(std::memory_order_relaxed))) {
+            find(fresh->key, preds, succs);
+        }
+        release(fresh);
+    };
+
+    // calls f(key, value) on live nodes from n on while in_range(key);
+    // f may return false to stop
+    template<typename InRange, typename F>
+    static void scan(Node *n, InRange &&in_range, F &f) {
+        for (; n && in_range(n->key); n = ptr(n->next[0].load(std::memory_order_acquire))) {
+            const V *v = n->value.load(std::memory_order_acquire);
+            if (!v) {
+                continue;
+            }
+            if constexpr (std::is_same_v<std::invoke_result_t<F &, const K &, const V &>, bool>) {
+                if (!f(n->key, *v)) {
+                    return;
+                }
+            } else {
+                f(n->key, *v);
+            }
+        }
+    };
+
+public:
+    ConcurrentSkipListMap() {
+        for (auto &l : head) {
+            l.store(0, std::memory_order_relaxed);
+        }
+    };
+    ConcurrentSkipListMap(const ConcurrentSkipListMap&) = delete;
+    ConcurrentSkipListMap& operator=(const ConcurrentSkipListMap&) = delete;
+    // must not race with any other operation
+    ~ConcurrentSkipListMap() {
+        Node *n = ptr(head[0].load(std::memory_order_relaxed));
+        while (n) {
+            Node *next = ptr(n->next[0].load(std::memory_order_relaxed));
+            delete n;
+            n = next;
+        }
+    };
+
+    std::shared_ptr<V> get(const K &k) const {
+        EpochReclaim::Guard guard;
+        Node *n = seek(k);
+        const V *v = n && equal(n->key, k) ? n->value.load(std::memory_order_acquire) : nullptr;
+        return v ? std::make_shared<V>(*v) : nullptr;
+    };
+    // f(const V&) on the stored value without copying it; false if k is absent
+    template<typename F>
+    bool visit(const K &k, F &&f) const {
+        EpochReclaim::Guard guard;
+        Node *n = seek(k);
+        const V *v = n && equal(n->key, k) ? n->value.load(std::memory_order_acquire) : nullptr;
+        if (!v) {
+            return false;
+        }
+        f(*v);
+        return true;
+    };
+
+    void set(const K &k, const V &v) { insert(k, new V(v)); };
+    void set(K &&k, V &&v) { insert(std::move(k), new V(std::move(v))); };
+
+    std::shared_ptr<V> remove(const K &k) {
+        EpochReclaim::Guard guard;
+        Link *preds[max_level];
+        Node *succs[max_level];
+        if (!find(k, preds, succs)) {
+            return nullptr;
+        }
+        Node *n = succs[0];
+        V *cur = n->value.load(std::memory_order_acquire);
+        do {
+            if (!cur) {
+                return nullptr;
+            }
+        } while (!n->value.compare_exchange_weak(cur, nullptr, std::memory_order_acq_rel,
+                                                 std::memory_order_acquire));
+        count.fetch_sub(1, std::memory_order_relaxed);
+        // readers may still hold cur, so it is copied out, not moved
+        auto p = std::make_shared<V>(*cur);
+        EpochReclaim::retire(cur);
+        mark(n);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        find(k, preds, succs);
+        release(n);
+        return p;
+    };
+
+    // first entry whose key is not less than k
+    std::optional<std::pair<K, V>> lower_bound(const K &k) const {
+        std::optional<std::pair<K, V>> out;
+        range_from(k, [&](const K &key, const V &v) {
+            out.emplace(key, v);
+            return false;
+        });
+        return out;
+    };
+
+    // Calls f(const K&, const V&) in key order for every entry in [lo, hi);
+    // f may return false to stop early. The scan takes no lock and is
+    // weakly consistent: entries present throughout are seen exactly once,
+    // ones inserted or removed meanwhile may or may not be. It pins an
+    // epoch while it runs, so a long scan delays reclamation, not writers.
+    template<typename F>
+    void range(const K &lo, const K &hi, F &&f) const {
+        EpochReclaim::Guard guard;
+        scan(seek(lo), [&](const K &key) { return less(key, hi); }, f);
+    };
+    // same, from lo to the end
+    template<typename F>
+    void range_from(const K &lo, F &&f) const {
+        EpochReclaim::Guard guard;
+        scan(seek(lo), [](const K &) { return true; }, f);
+    };
+    template<typename F>
+    void for_each(F &&f) const {
+        EpochReclaim::Guard guard;
+        scan(ptr(head[0].load(std::memory_order_acquire)), [](const K &) { return true; }, f);
+    };
+
+    std::size_t size() const { return count.load(std::memory_order_relaxed); };
+    bool empty() const { return size() == 0; };
+};
+#endif // SKIP_LIST_MAP_H_
@@ -0,0 +1,108 @@
+#include "spsc-ring.h"
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main() {
+    SpscRing<std::string> ring(3);
+    assert(ring.capacity() == 4 && ring.empty());
+    std::string s;
+    const bool pushed_a = ring.try_push(std::string("a"));
+    const bool pushed_b = ring.try_push(std::string("b"));
+    assert(pushed_a && pushed_b);
+    const bool popped_a = ring.try_pop(s);
+    assert(popped_a && s == "a" && ring.size() == 1);
+
+    // the reserved run stops at the end of the array
+    auto w = ring.reserve(4);
+    assert(w.size == 2);
+    w.data[0] = "c";
+    w.data[1] = "d";
+    assert(ring.size() == 1);
+    ring.commit(2);
+    const bool pushed_e = ring.try_push(std::string("e"));
+    const bool pushed_f = ring.try_push(std::string("f"));
+    assert(pushed_e && !pushed_f);
+    auto r = ring.peek(8);
+    assert(r.size == 3 && r.data[0] == "b" && r.data[2] == "d");
+    ring.release(3);
+    const bool popped_e = ring.try_pop(s);
+    assert(popped_e && s == "e");
+    const bool popped_empty = ring.try_pop(s);
+    assert(!popped_empty);
+
+    // move-only payloads
+    SpscRing<std::unique_ptr<int>> owned(2);
+    const bool pushed_owned = owned.try_push(std::make_unique<int>(7));
+    std::unique_ptr<int> p;
+    const bool popped_owned = owned.try_pop(p);
+    assert(pushed_owned && popped_owned && *p == 7);
+
+    // one producer mixing single, bulk and reserve/commit writes; one
+    // consumer mixing single, bulk and peek/release reads
+    const std::uint64_t n = 1000000;
+    SpscRing<std::uint64_t> link(256);
+    std::thread producer([&] {
+        std::uint64_t next = 0;
+        std::vector<std::uint64_t> buf;
+        while (next < n) {
+            switch (next % 3) {
+            case 0:
+                if (link.try_push(next)) {
+                    next++;
+                }
+                break;
+            case 1: {
+                buf.clear();
+                for (std::uint64_t i = next; i < std::min(n, next + 17); i++) {
+                    buf.push_back(i);
+                }
+                next += link.try_push_bulk(buf.begin(), buf.size());
+                break;
+            }
+            default: {
+                auto region = link.reserve(std::min<std::uint64_t>(n - next, 31));
+                for (std::size_t i = 0; i < region.size; i++) {
+                    region.data[i] = next + i;
+                }
+                link.commit(region.size);
+                next += region.size;
+            }
+            }
+        }
+    });
+    std::uint64_t expect = 0;
+    std::vector<std::uint64_t> got;
+    while (expect < n) {
+        switch (expect % 3) {
+        case 0:
+            if (std::uint64_t v; link.try_pop(v)) {
+                assert(v == expect);
+                expect++;
+            }
+            break;
+        case 1:
+            got.clear();
+            link.try_pop_bulk(std::back_inserter(got), 13);
+            for (auto v : got) {
+                assert(v == expect);
+                expect++;
+            }
+            break;
+        default: {
+            auto region = link.peek(29);
+            for (std::size_t i = 0; i < region.size; i++) {
+                assert(region.data[i] == expect);
+                expect++;
+            }
+            link.release(region.size);
+        }
+        }
+    }
+    producer.join();
+    assert(link.empty());
+    return 0;
+}
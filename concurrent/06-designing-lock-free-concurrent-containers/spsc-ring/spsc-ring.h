@@ -0,0 +1,149 @@
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Bounded single-producer single-consumer ring. Each side owns one index and
+// keeps a private copy of the other side's; it only reloads the shared
+// index when the copy says the ring is full (producer) or empty (consumer),
+// so in steady state neither side touches the other's cache line. Every
+// operation is wait-free: a fixed number of steps, no retry loop.
+//
+// Slots hold default-constructed Ts that are overwritten in place, which is
+// what lets reserve()/commit() hand out slots to fill without a copy.
+template<typename T>
+class SpscRing {
+    static_assert(std::is_default_constructible_v<T> && std::is_move_assignable_v<T>,
+                  "SpscRing slots are default-constructed and assigned in place");
+private:
+    static constexpr std::size_t cache_line = 64;
+
+    const std::size_t mask;
+    std::unique_ptr<T[]> slots;
+    // producer's line
+    alignas(cache_line) std::atomic<std::size_t> tail{0};
+    std::size_t head_cache = 0;
+    // consumer's line
+    alignas(cache_line) std::atomic<std::size_t> head{0};
+    std::size_t tail_cache = 0;
+
+    static std::size_t round_up(std::size_t n) {
+        std::size_t cap = 2;
+        while (cap < n) {
+            cap <<= 1;
+        }
+        return cap;
+    };
+
+    // free slots as seen by the producer, refreshing head only if needed
+    std::size_t writable(std::size_t t, std::size_t want) {
+        std::size_t free = capacity() - (t - head_cache);
+        if (free < want) {
+            head_cache = head.load(std::memory_order_acquire);
+            free = capacity() - (t - head_cache);
+        }
+        return free;
+    };
+    std::size_t readable(std::size_t h, std::size_t want) {
+        std::size_t avail = tail_cache - h;
+        if (avail < want) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            avail = tail_cache - h;
+        }
+        return avail;
+    };
+
+public:
+    // a contiguous run of slots, shorter than asked for at the wrap point
+    struct Region {
+        T *data;
+        std::size_t size;
+    };
+
+    explicit SpscRing(std::size_t capacity = 1024)
+        : mask(round_up(capacity) - 1), slots(new T[mask + 1]) {};
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    // producer only
+
+    template<typename U>
+    bool try_push(U &&value) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (writable(t, 1) == 0) {
+            return false;
+        }
+        slots[t & mask] = std::forward<U>(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    };
+    // moves up to n values from first; returns how many were taken
+    template<typename InputIt>
+    std::size_t try_push_bulk(InputIt first, std::size_t n) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        n = std::min(n, writable(t, n));
+        for (std::size_t i = 0; i < n; ++i, ++first) {
+            slots[(t + i) & mask] = std::move(*first);
+        }
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    };
+    // Up to n free slots to fill in place, published by commit(); size 0
+    // means the ring is full. Nothing is visible to the consumer before
+    // commit, and reserving again without committing returns the same run.
+    Region reserve(std::size_t n) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        const std::size_t i = t & mask;
+        n = std::min({n, writable(t, n), capacity() - i});
+        return {&slots[i], n};
+    };
+    void commit(std::size_t n) {
+        tail.store(tail.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    };
+
+    // consumer only
+
+    bool try_pop(T &out) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (readable(h, 1) == 0) {
+            return false;
+        }
+        out = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    };
+    template<typename OutputIt>
+    std::size_t try_pop_bulk(OutputIt out, std::size_t max_n) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        const std::size_t n = std::min(max_n, readable(h, max_n));
+        for (std::size_t i = 0; i < n; ++i) {
+            *out++ = std::move(slots[(h + i) & mask]);
+        }
+        head.store(h + n, std::memory_order_release);
+        return n;
+    };
+    // up to n filled slots to read in place, handed back by release()
+    Region peek(std::size_t n) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        const std::size_t i = h & mask;
+        n = std::min({n, readable(h, n), capacity() - i});
+        return {&slots[i], n};
+    };
+    void release(std::size_t n) {
+        head.store(head.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    };
+
+    // either side; exact only when the other side is idle
+    std::size_t size() const {
+        // head first: tail only grows, so it cannot fall behind the head read
+        const std::size_t h = head.load(std::memory_order_acquire);
+        return tail.load(std::memory_order_acquire) - h;
+    };
+    bool empty() const { return size() == 0; };
+    std::size_t capacity() const { return mask + 1; };
+};
+#endif // SPSC_RING_H_
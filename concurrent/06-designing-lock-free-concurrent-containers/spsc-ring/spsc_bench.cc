@@ -0,0 +1,129 @@
+#include "mpmc-ring-queue.h"
+#include "spsc-ring.h"
+#include "threadsafe-queue.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// One producer and one consumer pass n integers over a single link.
+// Reported in messages per second.
+
+using Clock = std::chrono::steady_clock;
+constexpr std::uint64_t n = 20000000;
+
+// a side that finds the link full or empty gives up its time slice only if
+// the other side cannot be running alongside it
+inline void idle() {
+    static const bool alone = std::thread::hardware_concurrency() < 2;
+    if (alone) {
+        std::this_thread::yield();
+    }
+}
+
+template<typename Produce, typename Consume>
+double run(Produce &&produce, Consume &&consume) {
+    const auto start = Clock::now();
+    std::thread producer(produce);
+    consume();
+    producer.join();
+    return n / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double spsc_single() {
+    SpscRing<std::uint64_t> ring(4096);
+    return run([&] {
+        for (std::uint64_t i = 0; i < n;) {
+            if (ring.try_push(i)) {
+                i++;
+            } else {
+                idle();
+            }
+        }
+    }, [&] {
+        std::uint64_t v;
+        for (std::uint64_t i = 0; i < n;) {
+            if (ring.try_pop(v)) {
+                i++;
+            } else {
+                idle();
+            }
+        }
+    });
+}
+
+double spsc_bulk() {
+    SpscRing<std::uint64_t> ring(4096);
+    return run([&] {
+        for (std::uint64_t i = 0; i < n;) {
+            auto w = ring.reserve(64);
+            for (std::size_t k = 0; k < w.size; k++) {
+                w.data[k] = i + k;
+            }
+            ring.commit(w.size);
+            i += w.size;
+            if (w.size == 0) {
+                idle();
+            }
+        }
+    }, [&] {
+        std::uint64_t sink = 0;
+        for (std::uint64_t i = 0; i < n;) {
+            auto r = ring.peek(64);
+            for (std::size_t k = 0; k < r.size; k++) {
+                sink += r.data[k];
+            }
+            ring.release(r.size);
+            i += r.size;
+            if (r.size == 0) {
+                idle();
+            }
+        }
+        std::printf("%s", sink == 0 ? " " : "");
+    });
+}
+
+double mpmc() {
+    MpmcRingQueue<std::uint64_t> q(4096);
+    return run([&] {
+        for (std::uint64_t i = 0; i < n;) {
+            if (q.try_push(i)) {
+                i++;
+            } else {
+                idle();
+            }
+        }
+    }, [&] {
+        std::uint64_t v;
+        for (std::uint64_t i = 0; i < n;) {
+            if (q.try_pop(v)) {
+                i++;
+            } else {
+                idle();
+            }
+        }
+    });
+}
+
+double locked() {
+    ThreadsafeQueue<std::uint64_t> q;
+    return run([&] {
+        for (std::uint64_t i = 0; i < n; i++) {
+            q.push(i);
+        }
+    }, [&] {
+        for (std::uint64_t i = 0; i < n; i++) {
+            q.wait_and_pop_value();
+        }
+    });
+}
+
+int main() {
+    std::printf("%-28s %12s\n", "link", "msgs/s");
+    std::printf("%-28s %12.3e\n", "SpscRing try_push/try_pop", spsc_single());
+    std::printf("%-28s %12.3e\n", "SpscRing reserve/peek x64", spsc_bulk());
+    std::printf("%-28s %12.3e\n", "MpmcRingQueue", mpmc());
+    std::printf("%-28s %12.3e\n", "ThreadsafeQueue", locked());
+    return 0;
+}
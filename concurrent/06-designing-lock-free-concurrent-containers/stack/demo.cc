@@ -0,0 +1,72 @@
+#include "lock-free-stack.h"
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// used as a LIFO work pool: every thread pushes and pops concurrently
+template<typename Reclaim>
+void run_work_pool() {
+    LockFreeStack<int, Reclaim> stack;
+    const int threads = 4, per_thread = 100000;
+    std::atomic<long long> popped_sum{0};
+    std::atomic<int> popped{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            long long sum = 0;
+            int n = 0;
+            for (int i = 0; i < per_thread; i++) {
+                stack.push(t * per_thread + i);
+                if (int x; i % 2 && stack.try_pop(x)) {
+                    sum += x;
+                    n++;
+                }
+            }
+            for (int x; stack.try_pop(x);) {
+                sum += x;
+                n++;
+            }
+            popped_sum += sum;
+            popped += n;
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    const long long total = static_cast<long long>(threads) * per_thread;
+    assert(popped == total && popped_sum == total * (total - 1) / 2);
+    assert(stack.empty());
+}
+
+int main() {
+    LockFreeStack<int> stack;
+    int v = -1;
+    const bool popped_empty = stack.try_pop(v);
+    const auto none = stack.try_pop();
+    assert(!popped_empty && v == -1 && none == nullptr && stack.empty());
+    stack.push(1);
+    stack.push(2);
+    const bool popped = stack.try_pop(v);
+    assert(popped && v == 2);
+    const auto one = stack.try_pop();
+    assert(one && *one == 1 && stack.empty());
+
+    run_work_pool<EpochReclaim>();
+    run_work_pool<HazardReclaim>();
+
+    // move-only values
+    LockFreeStack<std::unique_ptr<std::string>> owned;
+    owned.push(std::make_unique<std::string>("moved"));
+    owned.emplace(new std::string("emplaced"));
+    std::unique_ptr<std::string> s;
+    const bool first = owned.try_pop(s);
+    assert(first && *s == "emplaced");
+    const bool second = owned.try_pop(s);
+    assert(second && *s == "moved");
+    const bool third = owned.try_pop(s);
+    assert(!third);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#ifndef LOCK_FREE_STACK_H_
+#define LOCK_FREE_STACK_H_
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "reclaim.h"
+
+// Treiber stack: push and pop are a single CAS on head. A popper reads
+// head->next before its CAS, so the node must not be freed or reused while
+// any popper may hold it; popped nodes are therefore retired through the
+// Reclaim policy (see reclaim.h) and pop protects head under its guard.
+// That also rules out ABA: an address cannot come back to the top of the
+// stack while a thread that loaded it still protects it.
+template<typename E, typename Reclaim=EpochReclaim>
+class LockFreeStack {
+private:
+    struct Node {
+        E value;
+        Node *next = nullptr;
+        template<typename... Args>
+        explicit Node(Args &&...args) : value(std::forward<Args>(args)...) {};
+    };
+
+    alignas(64) std::atomic<Node *> head{nullptr};
+
+    void push_node(Node *n) {
+        n->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(n->next, n, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+        }
+    };
+    Node *pop_node(typename Reclaim::Guard &guard) {
+        for (;;) {
+            Node *h = guard.protect(0, head);
+            if (!h || head.compare_exchange_weak(h, h->next, std::memory_order_acquire,
+                                                 std::memory_order_relaxed)) {
+                return h;
+            }
+        }
+    };
+
+public:
+    LockFreeStack() = default;
+    LockFreeStack(const LockFreeStack &) = delete;
+    LockFreeStack &operator=(const LockFreeStack &) = delete;
+    // must not race with any other operation
+    ~LockFreeStack() {
+        Node *n = head.load(std::memory_order_relaxed);
+        while (n) {
+            Node *next = n->next;
+            delete n;
+            n = next;
+        }
+    };
+
+    void push(const E &element) { push_node(new Node(element)); };
+    void push(E &&element) { push_node(new Node(std::move(element))); };
+    template<typename... Args>
+    void emplace(Args &&...args) { push_node(new Node(std::forward<Args>(args)...)); };
+
+    // never throws for a nothrow-move-assignable E; false if the stack is empty
+    bool try_pop(E &out) {
+        typename Reclaim::Guard guard;
+        Node *n = pop_node(guard);
+        if (!n) {
+            return false;
+        }
+        // once unlinked nobody else touches value, only next
+        out = std::move(n->value);
+        guard.reset(0);
+        Reclaim::retire(n);
+        return true;
+    };
+    std::unique_ptr<E> try_pop() {
+        typename Reclaim::Guard guard;
+        Node *n = pop_node(guard);
+        if (!n) {
+            return nullptr;
+        }
+        auto p = std::make_unique<E>(std::move(n->value));
+        guard.reset(0);
+        Reclaim::retire(n);
+        return p;
+    };
+
+    // a snapshot; may be stale as soon as it returns
+    bool empty() const { return head.load(std::memory_order_acquire) == nullptr; };
+};
+#endif // LOCK_FREE_STACK_H_
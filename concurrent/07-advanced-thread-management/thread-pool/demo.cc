@@ -0,0 +1,46 @@
+#include "thread-pool.h"
+#include <cassert>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+long fib(ThreadPool &pool, int n) {
+    if (n < 16) {
+        return n < 2 ? n : fib(pool, n - 1) + fib(pool, n - 2);
+    }
+    auto left = pool.submit(fib, std::ref(pool), n - 1);
+    long right = fib(pool, n - 2);
+    pool.wait_until_ready(left);
+    return left.get() + right;
+}
+
+int main() {
+    ThreadPool pool;
+    const long f = fib(pool, 25);
+    assert(f == 75025);
+
+    std::vector<long> data(1 << 20);
+    std::iota(data.begin(), data.end(), 0);
+    std::vector<std::future<long>> parts;
+    const std::size_t chunk = 4096;
+    for (std::size_t i = 0; i < data.size(); i += chunk) {
+        parts.push_back(pool.submit([&data, i, chunk] {
+            return std::accumulate(data.begin() + i, data.begin() + i + chunk, 0L);
+        }));
+    }
+    pool.wait_for_pending_tasks();
+    long sum = 0;
+    for (auto &p : parts) {
+        sum += p.get();
+    }
+    const long n = static_cast<long>(data.size());
+    assert(sum == n * (n - 1) / 2);
+
+    auto failing = pool.submit([] { throw std::runtime_error("task failed"); });
+    try {
+        failing.get();
+        assert(false);
+    } catch (const std::runtime_error &) {
+    }
+    return 0;
+}
@@ -1,3 +1,5 @@
+#ifndef __JOINING_THREAD_H__
+#define __JOINING_THREAD_H__
 #include <thread>
 #include <utility>
 
@@ -36,3 +38,4 @@ class joining_thread {
         std::thread &as_thread() noexcept { return t; }
         const std::thread &as_thread() const noexcept { return t; }
 };
+#endif // __JOINING_THREAD_H__
@@ -0,0 +1,255 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "joining-thread.h"
+#include "threadsafe-queue.h"
+#include "work-stealing-deque.h"
+
+// Work-stealing pool. Each worker owns a Chase-Lev deque: tasks submitted
+// from a worker go to its own deque (LIFO, cache-warm), tasks from other
+// threads go to a shared injection queue, and an idle worker steals from
+// the top of a randomly chosen victim's deque before it parks.
+class ThreadPool {
+private:
+    static constexpr std::size_t cache_line = 64;
+    static constexpr int spin_rounds = 64;
+
+    struct Task {
+        virtual ~Task() = default;
+        virtual void run() = 0;
+    };
+    template <typename F> struct TaskImpl : Task {
+        F f;
+        explicit TaskImpl(F &&f) : f(std::move(f)) {}
+        void run() override { f(); }
+    };
+
+    // only the owning worker writes submitted/completed, so counting
+    // needs no shared RMW
+    struct alignas(cache_line) Worker {
+        WorkStealingDeque<Task *> deque;
+        std::atomic<std::uint64_t> submitted{0};
+        std::atomic<std::uint64_t> completed{0};
+    };
+
+    std::atomic<bool> done{false};
+    std::vector<std::unique_ptr<Worker>> workers;
+    ThreadsafeQueue<Task *> injected;
+    alignas(cache_line) std::atomic<std::uint64_t> external_submitted{0};
+    alignas(cache_line) std::atomic<std::uint64_t> external_completed{0};
+    alignas(cache_line) std::atomic<std::uint32_t> wake_epoch{0};
+    std::atomic<std::uint32_t> sleepers{0};
+    // declared last so the threads are joined before anything they use is destroyed
+    std::vector<joining_thread> threads;
+
+    static thread_local ThreadPool *local_pool;
+    static thread_local Worker *local_worker;
+    static thread_local std::uint64_t rng_state;
+
+    static std::uint64_t next_random() {
+        rng_state ^= rng_state << 13;
+        rng_state ^= rng_state >> 7;
+        rng_state ^= rng_state << 17;
+        return rng_state;
+    }
+
+    Worker *my_worker() const { return local_pool == this ? local_worker : nullptr; }
+
+    void enqueue(Task *t) {
+        if (Worker *w = my_worker()) {
+            w->submitted.store(w->submitted.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+            w->deque.push(t);
+        } else {
+            external_submitted.fetch_add(1, std::memory_order_relaxed);
+            injected.push(t);
+        }
+        wake_one();
+    }
+
+    void wake_one() {
+        // pairs with the fence in park()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) != 0) {
+            wake_epoch.fetch_add(1, std::memory_order_release);
+            wake_epoch.notify_one();
+        }
+    }
+
+    bool steal(Task *&t) {
+        const std::size_t n = workers.size();
+        const std::size_t start = next_random() % n;
+        for (std::size_t i = 0; i < n; i++) {
+            Worker *victim = workers[(start + i) % n].get();
+            if (victim != my_worker() && victim->deque.steal(t)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool has_work() {
+        if (!injected.empty()) {
+            return true;
+        }
+        for (auto &w : workers) {
+            if (!w->deque.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void park() {
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto seen = wake_epoch.load(std::memory_order_acquire);
+        if (!done.load(std::memory_order_acquire) && !has_work()) {
+            wake_epoch.wait(seen, std::memory_order_acquire);
+        }
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void worker_loop(Worker *w) {
+        local_pool = this;
+        local_worker = w;
+        rng_state = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+        while (!done.load(std::memory_order_acquire)) {
+            bool ran = false;
+            for (int i = 0; i < spin_rounds && !ran; i++) {
+                ran = run_pending_task();
+            }
+            if (!ran) {
+                park();
+            }
+        }
+    }
+
+    std::uint64_t pending() const {
+        // completed counts are read before submitted ones: each counter only
+        // grows, so the difference never undercounts what was pending
+        std::uint64_t completed = external_completed.load(std::memory_order_acquire);
+        for (auto &w : workers) {
+            completed += w->completed.load(std::memory_order_acquire);
+        }
+        std::uint64_t submitted = external_submitted.load(std::memory_order_acquire);
+        for (auto &w : workers) {
+            submitted += w->submitted.load(std::memory_order_acquire);
+        }
+        return submitted - completed;
+    }
+
+public:
+    explicit ThreadPool(unsigned n_threads = std::max(1u, std::thread::hardware_concurrency())) {
+        n_threads = std::max(1u, n_threads);
+        for (unsigned i = 0; i < n_threads; i++) {
+            workers.push_back(std::make_unique<Worker>());
+        }
+        try {
+            for (unsigned i = 0; i < n_threads; i++) {
+                threads.emplace_back(&ThreadPool::worker_loop, this, workers[i].get());
+            }
+        } catch (...) {
+            done = true;
+            wake_epoch.fetch_add(1);
+            wake_epoch.notify_all();
+            throw;
+        }
+    }
+    ThreadPool(const ThreadPool &other) = delete;
+    ThreadPool &operator=(const ThreadPool &other) = delete;
+    ~ThreadPool() {
+        done.store(true, std::memory_order_release);
+        wake_epoch.fetch_add(1, std::memory_order_release);
+        wake_epoch.notify_all();
+        for (auto &t : threads) {
+            t.join();
+        }
+        Task *t;
+        while (injected.try_pop(t)) {
+            delete t;
+        }
+        for (auto &w : workers) {
+            while (w->deque.steal(t)) {
+                delete t;
+            }
+        }
+    }
+
+    template <typename F, typename... Args>
+    auto submit(F &&f, Args &&...args) -> std::future<std::invoke_result_t<F, Args...>> {
+        using R = std::invoke_result_t<F, Args...>;
+        std::packaged_task<R()> task(
+            [f = std::forward<F>(f), tup = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+                return std::apply(std::move(f), std::move(tup));
+            });
+        auto result = task.get_future();
+        enqueue(new TaskImpl<std::packaged_task<R()>>(std::move(task)));
+        return result;
+    }
+
+    // fire-and-forget: there is no future to carry an exception, so f must not throw
+    template <typename F> void execute(F &&f) {
+        enqueue(new TaskImpl<std::decay_t<F>>(std::decay_t<F>(std::forward<F>(f))));
+    }
+
+    // runs one queued task on the calling thread: own deque first, then the
+    // injection queue, then a steal; returns false if nothing was found
+    bool run_pending_task() {
+        Worker *w = my_worker();
+        Task *t = nullptr;
+        if (!(w && w->deque.pop(t)) && !injected.try_pop(t) && !steal(t)) {
+            return false;
+        }
+        t->run();
+        delete t;
+        if (w) {
+            w->completed.store(w->completed.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_release);
+        } else {
+            external_completed.fetch_add(1, std::memory_order_release);
+        }
+        return true;
+    }
+
+    // Helps execute tasks until every task submitted so far has finished.
+    // Must not be called from inside a task, which would wait for itself;
+    // a task should wait on the futures it needs with wait_until_ready().
+    void wait_for_pending_tasks() {
+        while (pending() != 0) {
+            if (!run_pending_task()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // runs other tasks until f is ready instead of blocking in f.wait()
+    template <typename R> void wait_until_ready(const std::future<R> &f) {
+        while (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!run_pending_task()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    std::size_t size() const { return workers.size(); }
+};
+
+inline thread_local ThreadPool *ThreadPool::local_pool = nullptr;
+inline thread_local ThreadPool::Worker *ThreadPool::local_worker = nullptr;
+inline thread_local std::uint64_t ThreadPool::rng_state = 0x9e3779b97f4a7c15ull;
+
+#endif // __THREAD_POOL_H__
@@ -0,0 +1,113 @@
+#ifndef __WORK_STEALING_DEQUE_H__
+#define __WORK_STEALING_DEQUE_H__
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Chase-Lev deque (Le et al., "Correct and Efficient Work-Stealing for
+// Weak Memory Models"). The owning thread pushes and pops at the bottom
+// without any RMW in the common case; other threads steal from the top
+// with a CAS. T must be trivially copyable, typically a pointer. Arrays
+// that were outgrown stay alive until the deque is destroyed, because a
+// thief may still be reading from one.
+template <typename T> class WorkStealingDeque {
+private:
+    static_assert(std::is_trivially_copyable_v<T>, "WorkStealingDeque stores T in atomics");
+    static constexpr std::size_t cache_line = 64;
+
+    struct Array {
+        const std::int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+        explicit Array(std::int64_t capacity) : mask(capacity - 1), slots(new std::atomic<T>[capacity]) {}
+        std::int64_t capacity() const { return mask + 1; }
+        T get(std::int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(std::int64_t i, T x) { slots[i & mask].store(x, std::memory_order_relaxed); }
+    };
+
+    alignas(cache_line) std::atomic<std::int64_t> top{0};
+    alignas(cache_line) std::atomic<std::int64_t> bottom{0};
+    std::atomic<Array *> array;
+    std::vector<std::unique_ptr<Array>> arrays;
+
+    Array *grow(Array *a, std::int64_t b, std::int64_t t) {
+        auto bigger = std::make_unique<Array>(a->capacity() * 2);
+        for (std::int64_t i = t; i < b; i++) {
+            bigger->put(i, a->get(i));
+        }
+        Array *p = bigger.get();
+        arrays.push_back(std::move(bigger));
+        array.store(p, std::memory_order_release);
+        return p;
+    }
+
+public:
+    explicit WorkStealingDeque(std::size_t capacity = 1024) {
+        std::int64_t cap = 2;
+        while (cap < static_cast<std::int64_t>(capacity)) {
+            cap <<= 1;
+        }
+        arrays.push_back(std::make_unique<Array>(cap));
+        array.store(arrays.back().get(), std::memory_order_relaxed);
+    }
+    WorkStealingDeque(const WorkStealingDeque &other) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &other) = delete;
+
+    // owner only
+    void push(T x) {
+        std::int64_t b = bottom.load(std::memory_order_relaxed);
+        std::int64_t t = top.load(std::memory_order_acquire);
+        Array *a = array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity() - 1) {
+            a = grow(a, b, t);
+        }
+        a->put(b, x);
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // owner only
+    bool pop(T &x) {
+        std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Array *a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        x = a->get(b);
+        if (t == b) {
+            // last element: race the thieves for it
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                   std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // any thread; fails on an empty deque or a lost race
+    bool steal(T &x) {
+        std::int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return false;
+        }
+        Array *a = array.load(std::memory_order_acquire);
+        x = a->get(t);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                           std::memory_order_relaxed);
+    }
+
+    bool empty() const {
+        std::int64_t b = bottom.load(std::memory_order_relaxed);
+        std::int64_t t = top.load(std::memory_order_relaxed);
+        return b <= t;
+    }
+};
+
+#endif // __WORK_STEALING_DEQUE_H__
@@ -0,0 +1,165 @@
+#ifndef __ASYNC_PRIMITIVES_H__
+#define __ASYNC_PRIMITIVES_H__
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "scheduler.h"
+#include "threadsafe-queue.h"
+
+// Mutex for coroutines: a contended lock() suspends the caller instead of
+// blocking its worker, and unlock() hands ownership straight to the oldest
+// waiter, which is resumed through the scheduler.
+//
+//     auto guard = co_await m.scoped_lock();
+class async_mutex {
+private:
+    scheduler &sched;
+    std::mutex m_;
+    bool locked = false;
+    std::deque<std::coroutine_handle<>> waiters;
+
+public:
+    class guard {
+    private:
+        async_mutex *m;
+
+    public:
+        explicit guard(async_mutex *m) : m(m) {}
+        guard(guard &&other) noexcept : m(std::exchange(other.m, nullptr)) {}
+        guard(const guard &other) = delete;
+        guard &operator=(const guard &other) = delete;
+        ~guard() {
+            if (m) {
+                m->unlock();
+            }
+        }
+    };
+
+    explicit async_mutex(scheduler &sched) : sched(sched) {}
+    async_mutex(const async_mutex &other) = delete;
+    async_mutex &operator=(const async_mutex &other) = delete;
+
+    bool try_lock() {
+        std::lock_guard<std::mutex> lk(m_);
+        return !std::exchange(locked, true);
+    }
+    auto lock() {
+        struct awaiter {
+            async_mutex &m;
+            bool await_ready() { return m.try_lock(); }
+            bool await_suspend(std::coroutine_handle<> h) {
+                std::lock_guard<std::mutex> lk(m.m_);
+                if (!m.locked) {
+                    m.locked = true;
+                    return false;
+                }
+                m.waiters.push_back(h);
+                return true;
+            }
+            void await_resume() noexcept {}
+        };
+        return awaiter{*this};
+    }
+    auto scoped_lock() {
+        struct awaiter {
+            decltype(std::declval<async_mutex &>().lock()) inner;
+            bool await_ready() { return inner.await_ready(); }
+            bool await_suspend(std::coroutine_handle<> h) { return inner.await_suspend(h); }
+            guard await_resume() noexcept { return guard(&inner.m); }
+        };
+        return awaiter{lock()};
+    }
+    void unlock() {
+        std::coroutine_handle<> next;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (waiters.empty()) {
+                locked = false;
+                return;
+            }
+            // locked stays true: ownership passes to next
+            next = waiters.front();
+            waiters.pop_front();
+        }
+        sched.resume(next);
+    }
+};
+
+// ThreadsafeQueue with a pop() coroutines can await. Values go through the
+// queue as usual; a consumer that finds it empty parks its handle here, and
+// the next push pops on its behalf and resumes it through the scheduler.
+// Blocking and awaiting consumers can share the same queue.
+template <typename T> class awaitable_queue {
+    static_assert(std::is_default_constructible_v<T>, "a parked pop needs a slot to receive into");
+
+private:
+    struct pop_awaiter {
+        awaitable_queue &q;
+        T value{};
+        std::coroutine_handle<> h{};
+
+        bool await_ready() { return q.queue.try_pop(value); }
+        bool await_suspend(std::coroutine_handle<> awaiting) {
+            std::lock_guard<std::mutex> lk(q.waiters_m_);
+            h = awaiting;
+            q.n_waiters.fetch_add(1);
+            // recheck after registering: a push that missed the count has
+            // linked its value before this try_pop takes the tail lock
+            if (q.queue.try_pop(value)) {
+                q.n_waiters.fetch_sub(1);
+                return false;
+            }
+            q.waiters.push_back(this);
+            return true;
+        }
+        T await_resume() { return std::move(value); }
+    };
+
+    scheduler &sched;
+    ThreadsafeQueue<T> queue;
+    std::mutex waiters_m_;
+    std::deque<pop_awaiter *> waiters;
+    std::atomic<std::size_t> n_waiters{0};
+
+    void hand_off() {
+        if (n_waiters.load() == 0) {
+            return;
+        }
+        std::vector<std::coroutine_handle<>> ready;
+        {
+            std::lock_guard<std::mutex> lk(waiters_m_);
+            while (!waiters.empty() && queue.try_pop(waiters.front()->value)) {
+                ready.push_back(waiters.front()->h);
+                waiters.pop_front();
+                n_waiters.fetch_sub(1);
+            }
+        }
+        for (auto h : ready) {
+            sched.resume(h);
+        }
+    }
+
+public:
+    explicit awaitable_queue(scheduler &sched) : sched(sched) {}
+
+    void push(const T &value) {
+        queue.push(value);
+        hand_off();
+    }
+    void push(T &&value) {
+        queue.push(std::move(value));
+        hand_off();
+    }
+    bool try_pop(T &value) { return queue.try_pop(value); }
+    // co_await q.pop() yields the next value, suspending while there is none
+    pop_awaiter pop() { return pop_awaiter{*this}; }
+    bool empty() { return queue.empty(); }
+};
+
+#endif // __ASYNC_PRIMITIVES_H__
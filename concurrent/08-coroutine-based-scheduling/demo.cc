@@ -0,0 +1,91 @@
+#include "async-primitives.h"
+#include "scheduler.h"
+#include "task.h"
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+task<long> fib(int n) {
+    if (n < 2) {
+        co_return n;
+    }
+    co_return co_await fib(n - 1) + co_await fib(n - 2);
+}
+
+task<int> fails() {
+    throw std::runtime_error("task failed");
+    co_return 0;
+}
+
+task<int> recovers() {
+    try {
+        co_await fails();
+    } catch (const std::runtime_error &) {
+        co_return 1;
+    }
+    co_return 0;
+}
+
+// sleeps, then bumps a counter that only the async_mutex protects
+task<void> sleeper(scheduler &s, async_mutex &m, long &counter, int i) {
+    co_await s.sleep_for(std::chrono::microseconds(i % 5000));
+    auto guard = co_await m.scoped_lock();
+    counter++;
+}
+
+task<void> consumer(awaitable_queue<int> &q, std::atomic<long> &sum) {
+    for (;;) {
+        int v = co_await q.pop();
+        if (v < 0) {
+            co_return;
+        }
+        sum.fetch_add(v, std::memory_order_relaxed);
+    }
+}
+
+int main() {
+    scheduler s(4);
+    const auto f = s.block_on(fib(20));
+    const auto recovered = s.block_on(recovers());
+    assert(f == 6765 && recovered == 1);
+    try {
+        s.block_on(fails());
+        assert(false);
+    } catch (const std::runtime_error &) {
+    }
+
+    // far more sleeping tasks than threads; none of them holds one
+    const int n = 200000;
+    async_mutex m(s);
+    long counter = 0;
+    for (int i = 0; i < n; i++) {
+        s.spawn(sleeper(s, m, counter, i));
+    }
+    s.wait_idle();
+    assert(counter == n);
+
+    // a plain thread feeds coroutines parked on an empty queue
+    const int consumers = 1000, values = 100000;
+    awaitable_queue<int> q(s);
+    std::atomic<long> sum{0};
+    for (int i = 0; i < consumers; i++) {
+        s.spawn(consumer(q, sum));
+    }
+    std::thread producer([&] {
+        for (int i = 1; i <= values; i++) {
+            q.push(i);
+        }
+        for (int i = 0; i < consumers; i++) {
+            q.push(-1);
+        }
+    });
+    producer.join();
+    s.wait_idle();
+    assert(sum == static_cast<long>(values) * (values + 1) / 2);
+    assert(q.empty());
+    return 0;
+}
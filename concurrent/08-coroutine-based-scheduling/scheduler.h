@@ -0,0 +1,194 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "joining-thread.h"
+#include "task.h"
+#include "thread-pool.h"
+
+// Runs coroutines on a work-stealing ThreadPool. A suspended coroutine
+// holds no thread: whatever it waits on (a timer, an async_mutex, an
+// awaitable_queue) hands its handle back through resume(), which queues
+// it on the pool. One timer thread keeps a heap of sleeping coroutines.
+//
+//     scheduler s;
+//     s.spawn(serve(s, conn));             // detached, fire-and-forget
+//     int r = s.block_on(compute(s));      // from a non-worker thread
+//
+// A scheduler must be idle (see wait_idle) before it is destroyed; any
+// coroutine still suspended then is leaked rather than resumed.
+class scheduler {
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct timer {
+        clock::time_point when;
+        std::coroutine_handle<> h;
+        bool operator>(const timer &other) const { return when > other.when; }
+    };
+
+    // a coroutine that starts eagerly and frees its own frame at the end
+    struct detached {
+        struct promise_type {
+            detached get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+    };
+
+    ThreadPool pool;
+    std::atomic<std::size_t> live{0};
+    std::mutex timer_m_;
+    std::condition_variable timer_cv;
+    std::priority_queue<timer, std::vector<timer>, std::greater<timer>> timers;
+    bool stopping = false;
+    // declared last so it is joined before the heap it reads is destroyed
+    joining_thread timer_thread;
+
+    void timer_loop() {
+        std::unique_lock<std::mutex> lk(timer_m_);
+        while (!stopping) {
+            if (timers.empty()) {
+                timer_cv.wait(lk);
+                continue;
+            }
+            const auto when = timers.top().when;
+            if (clock::now() < when) {
+                timer_cv.wait_until(lk, when);
+                continue;
+            }
+            std::vector<std::coroutine_handle<>> due;
+            const auto now = clock::now();
+            while (!timers.empty() && timers.top().when <= now) {
+                due.push_back(timers.top().h);
+                timers.pop();
+            }
+            lk.unlock();
+            for (auto h : due) {
+                resume(h);
+            }
+            lk.lock();
+        }
+    }
+
+public:
+    explicit scheduler(unsigned n_threads = std::max(1u, std::thread::hardware_concurrency()))
+        : pool(n_threads), timer_thread(&scheduler::timer_loop, this) {}
+    scheduler(const scheduler &other) = delete;
+    scheduler &operator=(const scheduler &other) = delete;
+    ~scheduler() {
+        {
+            std::lock_guard<std::mutex> lk(timer_m_);
+            stopping = true;
+        }
+        timer_cv.notify_one();
+    }
+
+    // queues h to be resumed on a worker
+    void resume(std::coroutine_handle<> h) {
+        pool.execute([h] { h.resume(); });
+    }
+
+    // co_await schedule() moves the awaiting coroutine onto a worker
+    auto schedule() {
+        struct awaiter {
+            scheduler &s;
+            bool await_ready() noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> h) { s.resume(h); }
+            void await_resume() noexcept {}
+        };
+        return awaiter{*this};
+    }
+
+    auto sleep_until(clock::time_point when) {
+        struct awaiter {
+            scheduler &s;
+            clock::time_point when;
+            bool await_ready() const { return when <= clock::now(); }
+            void await_suspend(std::coroutine_handle<> h) {
+                // this awaiter lives in the frame, which the timer thread may
+                // resume and free as soon as the lock is dropped
+                scheduler &sched = s;
+                bool earliest;
+                {
+                    std::lock_guard<std::mutex> lk(sched.timer_m_);
+                    earliest = sched.timers.empty() || when < sched.timers.top().when;
+                    sched.timers.push({when, h});
+                }
+                if (earliest) {
+                    sched.timer_cv.notify_one();
+                }
+            }
+            void await_resume() noexcept {}
+        };
+        return awaiter{*this, when};
+    }
+    template <typename Rep, typename Period> auto sleep_for(std::chrono::duration<Rep, Period> d) {
+        return sleep_until(clock::now() + std::chrono::duration_cast<clock::duration>(d));
+    }
+
+    // starts t on a worker and lets it run to completion on its own
+    void spawn(task<void> t) {
+        live.fetch_add(1, std::memory_order_relaxed);
+        run_detached(std::move(t));
+    }
+
+    // Runs t on the pool and blocks the calling thread for its result.
+    // Must not be called from a worker, which it would tie up.
+    template <typename T> T block_on(task<T> t) {
+        std::promise<T> result;
+        auto f = result.get_future();
+        run_and_signal(std::move(t), std::move(result));
+        return f.get();
+    }
+
+    // blocks until every spawned task has finished
+    void wait_idle() {
+        for (std::size_t n; (n = live.load(std::memory_order_acquire)) != 0;) {
+            live.wait(n, std::memory_order_acquire);
+        }
+    }
+
+    std::size_t size() const { return pool.size(); }
+
+private:
+    // an exception escaping a spawned task ends the process, as it would
+    // escaping a std::thread
+    detached run_detached(task<void> t) {
+        co_await schedule();
+        co_await std::move(t);
+        if (live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            live.notify_all();
+        }
+    }
+
+    template <typename T> detached run_and_signal(task<T> t, std::promise<T> out) {
+        co_await schedule();
+        try {
+            if constexpr (std::is_void_v<T>) {
+                co_await std::move(t);
+                out.set_value();
+            } else {
+                out.set_value(co_await std::move(t));
+            }
+        } catch (...) {
+            out.set_exception(std::current_exception());
+        }
+    }
+};
+
+#endif // __SCHEDULER_H__
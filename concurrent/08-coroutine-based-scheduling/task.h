@@ -0,0 +1,103 @@
+#ifndef __TASK_H__
+#define __TASK_H__
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Lazily started coroutine producing a T. Nothing runs until the task is
+// co_awaited; the awaiter is then resumed by symmetric transfer when the
+// body finishes, so long chains of awaits do not grow the stack. An
+// exception escaping the body is rethrown from the co_await.
+template <typename T = void> class task;
+
+struct task_promise_base {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr error;
+
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename P> std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+            return h.promise().continuation;
+        }
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    final_awaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+template <typename T> struct task_promise : task_promise_base {
+    std::optional<T> value;
+    task<T> get_return_object();
+    template <typename U> void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+    T result() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return std::move(*value);
+    }
+};
+
+template <> struct task_promise<void> : task_promise_base {
+    task<void> get_return_object();
+    void return_void() {}
+    void result() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+template <typename T> class task {
+public:
+    using promise_type = task_promise<T>;
+
+private:
+    std::coroutine_handle<promise_type> coro;
+
+public:
+    explicit task(std::coroutine_handle<promise_type> h) : coro(h) {}
+    task(task &&other) noexcept : coro(std::exchange(other.coro, nullptr)) {}
+    task &operator=(task &&other) noexcept {
+        if (this != &other) {
+            if (coro) {
+                coro.destroy();
+            }
+            coro = std::exchange(other.coro, nullptr);
+        }
+        return *this;
+    }
+    task(const task &other) = delete;
+    task &operator=(const task &other) = delete;
+    ~task() {
+        if (coro) {
+            coro.destroy();
+        }
+    }
+
+    auto operator co_await() && noexcept {
+        struct awaiter {
+            std::coroutine_handle<promise_type> coro;
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                coro.promise().continuation = awaiting;
+                return coro;
+            }
+            T await_resume() { return coro.promise().result(); }
+        };
+        return awaiter{coro};
+    }
+};
+
+template <typename T> task<T> task_promise<T>::get_return_object() {
+    return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+}
+
+inline task<void> task_promise<void>::get_return_object() {
+    return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+}
+
+#endif // __TASK_H__
@@ -0,0 +1,211 @@
+#ifndef BENCH_UTIL_H_
+#define BENCH_UTIL_H_
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// xorshift64*; one per worker thread
+class Rng {
+private:
+    std::uint64_t s;
+
+public:
+    explicit Rng(std::uint64_t seed) : s(seed * 0x9e3779b97f4a7c15ull | 1) {};
+    std::uint64_t next() {
+        s ^= s >> 12;
+        s ^= s << 25;
+        s ^= s >> 27;
+        return s * 0x2545f4914f6cdd1dull;
+    };
+    // uniform in [0, 1)
+    double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); };
+};
+
+// YCSB's Zipfian generator (Gray et al., "Quickly Generating Billion-Record
+// Synthetic Databases"): key 0 is the hottest. Immutable once built, so one
+// instance is shared by every thread.
+class Zipf {
+private:
+    const std::uint64_t n;
+    const double theta, alpha, zetan, eta;
+
+    static double zeta(std::uint64_t n, double theta) {
+        double sum = 0;
+        for (std::uint64_t i = 1; i <= n; i++) {
+            sum += 1.0 / std::pow(static_cast<double>(i), theta);
+        }
+        return sum;
+    };
+
+public:
+    Zipf(std::uint64_t n, double theta)
+        : n(n), theta(theta), alpha(1.0 / (1.0 - theta)), zetan(zeta(n, theta)),
+          eta((1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta(2, theta) / zetan)) {};
+    std::uint64_t next(Rng &rng) const {
+        const double u = rng.unit();
+        const double uz = u * zetan;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < 1.0 + std::pow(0.5, theta)) {
+            return 1;
+        }
+        return std::min<std::uint64_t>(n - 1, static_cast<std::uint64_t>(
+                                                  n * std::pow(eta * u - eta + 1.0, alpha)));
+    };
+};
+
+// Log-linear latency histogram in ns: exact below 16, then 16 linear
+// sub-buckets per power of two, so any percentile is within 1/16.
+class Histogram {
+private:
+    static constexpr int sub_bits = 4;
+    static constexpr int sub = 1 << sub_bits;
+    static constexpr int max_exp = 40;
+    std::array<std::uint64_t, sub + (max_exp - sub_bits) * sub> counts{};
+
+    static std::size_t index(std::uint64_t ns) {
+        if (ns < sub) {
+            return ns;
+        }
+        int exp = 63 - __builtin_clzll(ns);
+        if (exp >= max_exp) {
+            exp = max_exp - 1;
+            ns = (std::uint64_t(1) << max_exp) - 1;
+        }
+        return sub + (exp - sub_bits) * sub + ((ns >> (exp - sub_bits)) & (sub - 1));
+    };
+    static std::uint64_t lower_bound(std::size_t i) {
+        if (i < sub) {
+            return i;
+        }
+        const int exp = static_cast<int>((i - sub) / sub) + sub_bits;
+        return (std::uint64_t(sub) | ((i - sub) % sub)) << (exp - sub_bits);
+    };
+
+public:
+    void record(std::uint64_t ns) { counts[index(ns)]++; };
+    void merge(const Histogram &other) {
+        for (std::size_t i = 0; i < counts.size(); i++) {
+            counts[i] += other.counts[i];
+        }
+    };
+    std::uint64_t percentile(double q) const {
+        std::uint64_t total = 0;
+        for (auto c : counts) {
+            total += c;
+        }
+        if (total == 0) {
+            return 0;
+        }
+        const auto rank = static_cast<std::uint64_t>(q * (total - 1));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < counts.size(); i++) {
+            seen += counts[i];
+            if (seen > rank) {
+                return lower_bound(i);
+            }
+        }
+        return lower_bound(counts.size() - 1);
+    };
+};
+
+struct Config {
+    std::string container;
+    std::string workload;
+    unsigned threads = 1;
+    // fraction of operations that read (maps) or pop (queues and stacks)
+    double read_ratio = 0.5;
+    std::string key_dist = "none";
+    std::size_t value_size = 8;
+};
+
+struct Result {
+    Config config;
+    double ops_per_sec;
+    std::uint64_t p50_ns, p99_ns, p999_ns;
+};
+
+// Runs op(rng) on config.threads threads for the given duration after a
+// common start signal. Every op counts towards throughput; every
+// sample_every-th op is also timed, which keeps clock overhead out of the
+// throughput figure.
+template<typename Op>
+Result measure(const Config &config, std::chrono::milliseconds duration, Op &&op) {
+    constexpr unsigned sample_every = 16;
+    std::atomic<bool> go{false}, stop{false};
+    std::atomic<unsigned> ready{0};
+    std::vector<Histogram> hists(config.threads);
+    std::vector<std::uint64_t> ops(config.threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < config.threads; t++) {
+        workers.emplace_back([&, t] {
+            Rng rng(t + 1);
+            Histogram h;
+            std::uint64_t n = 0;
+            ready++;
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (unsigned i = 0; i < 4 * sample_every; i++, n++) {
+                    if (n % sample_every == 0) {
+                        const auto start = Clock::now();
+                        op(rng);
+                        h.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+                    } else {
+                        op(rng);
+                    }
+                }
+            }
+            hists[t] = h;
+            ops[t] = n;
+        });
+    }
+    while (ready.load() != config.threads) {
+        std::this_thread::yield();
+    }
+    const auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto &w : workers) {
+        w.join();
+    }
+    const double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    Histogram all;
+    std::uint64_t total = 0;
+    for (unsigned t = 0; t < config.threads; t++) {
+        all.merge(hists[t]);
+        total += ops[t];
+    }
+    return {config, total / secs, all.percentile(0.5), all.percentile(0.99), all.percentile(0.999)};
+}
+
+inline void write_json(std::FILE *f, const std::vector<Result> &results) {
+    std::fprintf(f, "[\n");
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        std::fprintf(f,
+                     "  {\"container\": \"%s\", \"workload\": \"%s\", \"threads\": %u, "
+                     "\"read_ratio\": %.3f, \"key_dist\": \"%s\", \"value_size\": %zu, "
+                     "\"ops_per_sec\": %.1f, \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu}%s\n",
+                     r.config.container.c_str(), r.config.workload.c_str(), r.config.threads,
+                     r.config.read_ratio, r.config.key_dist.c_str(), r.config.value_size,
+                     r.ops_per_sec, static_cast<unsigned long long>(r.p50_ns),
+                     static_cast<unsigned long long>(r.p99_ns),
+                     static_cast<unsigned long long>(r.p999_ns), i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(f, "]\n");
+}
+#endif // BENCH_UTIL_H_
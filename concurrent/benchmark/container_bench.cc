@@ -0,0 +1,199 @@
+#include "bench_util.h"
+#include "lock-free-stack.h"
+#include "mpmc-ring-queue.h"
+#include "rcu_hash_map.h"
+#include "skip-list-map.h"
+#include "threadsafe-deque.h"
+#include "threadsafe-queue.h"
+#include "threadsafe_stack.h"
+#include "unordered_map.h"
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Drives every container across thread counts, read/write ratios, key
+// distributions and value sizes; prints a table and writes every run as
+// JSON (see write_json) so runs can be diffed or plotted.
+//
+//   container_bench [--threads 1,2,4] [--ms 100] [--only map] [--out bench.json]
+
+template<std::size_t N>
+struct Payload {
+    std::array<char, N> bytes{};
+};
+
+constexpr std::uint64_t keys = 1 << 16;
+constexpr std::size_t prefill = 1024;
+
+struct Options {
+    std::vector<unsigned> threads;
+    std::chrono::milliseconds duration{100};
+    std::string only;
+    std::string out = "bench.json";
+};
+
+// read_ratio is the fraction of pops; popping an empty container counts as
+// an operation, as it would for a consumer polling
+template<typename Container, typename Push, typename Pop>
+Result queue_run(const Config &c, const Options &o, Push push, Pop pop) {
+    Container q;
+    for (std::size_t i = 0; i < prefill; i++) {
+        push(q);
+    }
+    return measure(c, o.duration, [&](Rng &rng) {
+        if (rng.unit() < c.read_ratio) {
+            pop(q);
+        } else {
+            push(q);
+        }
+    });
+}
+
+template<std::size_t N>
+void queues(const Options &o, Config c, std::vector<Result> &out) {
+    using V = Payload<N>;
+    c.workload = "push_pop";
+    auto run = [&](const char *name, auto &&f) {
+        if (o.only.empty() || std::string(name).find(o.only) != std::string::npos) {
+            c.container = name;
+            out.push_back(f());
+        }
+    };
+    run("ThreadsafeQueue", [&] {
+        return queue_run<ThreadsafeQueue<V>>(c, o, [](auto &q) { q.push(V{}); },
+                                             [](auto &q) { V v; q.try_pop(v); });
+    });
+    run("ThreadSafeQueue", [&] {
+        return queue_run<ThreadSafeQueue<V>>(c, o, [](auto &q) { q.push(V{}); },
+                                             [](auto &q) { V v; q.try_pop(&v); });
+    });
+    run("MpmcRingQueue", [&] {
+        return queue_run<MpmcRingQueue<V>>(c, o, [](auto &q) { q.try_push(V{}); },
+                                           [](auto &q) { V v; q.try_pop(v); });
+    });
+    run("threadsafe_stack", [&] {
+        return queue_run<threadsafe_stack<V>>(c, o, [](auto &s) { s.push(V{}); },
+                                              [](auto &s) {
+                                                  V v;
+                                                  try {
+                                                      s.pop(&v);
+                                                  } catch (const std::exception &) {
+                                                  }
+                                              });
+    });
+    run("LockFreeStack", [&] {
+        return queue_run<LockFreeStack<V>>(c, o, [](auto &s) { s.push(V{}); },
+                                           [](auto &s) { V v; s.try_pop(v); });
+    });
+}
+
+template<typename Map, typename V>
+Result map_run(const Config &c, const Options &o, const Zipf *zipf) {
+    Map m;
+    for (std::uint64_t k = 0; k < keys; k++) {
+        m.set(k, V{});
+    }
+    return measure(c, o.duration, [&](Rng &rng) {
+        const std::uint64_t k = zipf ? zipf->next(rng) : rng.next() & (keys - 1);
+        if (rng.unit() < c.read_ratio) {
+            m.visit(k, [](const V &) {});
+        } else {
+            m.set(k, V{});
+        }
+    });
+}
+
+template<std::size_t N>
+void maps(const Options &o, Config c, const Zipf *zipf, std::vector<Result> &out) {
+    using V = Payload<N>;
+    c.workload = "get_set";
+    c.key_dist = zipf ? "zipf0.99" : "uniform";
+    if (o.only.empty() || std::string("ConcurrentHashMap").find(o.only) != std::string::npos) {
+        c.container = "ConcurrentHashMap";
+        out.push_back(map_run<ConcurrentHashMap<std::uint64_t, V>, V>(c, o, zipf));
+    }
+    if (o.only.empty() || std::string("RcuHashMap").find(o.only) != std::string::npos) {
+        c.container = "RcuHashMap";
+        out.push_back(map_run<RcuHashMap<std::uint64_t, V>, V>(c, o, zipf));
+    }
+    if (o.only.empty() || std::string("ConcurrentSkipListMap").find(o.only) != std::string::npos) {
+        c.container = "ConcurrentSkipListMap";
+        out.push_back(map_run<ConcurrentSkipListMap<std::uint64_t, V>, V>(c, o, zipf));
+    }
+}
+
+template<std::size_t N>
+void sweep(const Options &o, const Zipf &zipf, std::vector<Result> &out) {
+    for (unsigned t : o.threads) {
+        Config c;
+        c.threads = t;
+        c.value_size = N;
+        c.read_ratio = 0.5;
+        queues<N>(o, c, out);
+        for (double r : {0.5, 0.9, 0.99}) {
+            c.read_ratio = r;
+            maps<N>(o, c, nullptr, out);
+            maps<N>(o, c, &zipf, out);
+        }
+    }
+}
+
+Options parse(int argc, char *argv[]) {
+    Options o;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!std::strcmp(argv[i], "--threads")) {
+            for (char *p = argv[i + 1]; *p;) {
+                o.threads.push_back(std::strtoul(p, &p, 10));
+                if (*p == ',') {
+                    p++;
+                }
+            }
+        } else if (!std::strcmp(argv[i], "--ms")) {
+            o.duration = std::chrono::milliseconds(std::atoi(argv[i + 1]));
+        } else if (!std::strcmp(argv[i], "--only")) {
+            o.only = argv[i + 1];
+        } else if (!std::strcmp(argv[i], "--out")) {
+            o.out = argv[i + 1];
+        } else {
+            throw std::invalid_argument(std::string("unknown option ") + argv[i]);
+        }
+    }
+    if (o.threads.empty()) {
+        for (unsigned t = 1; t <= 2 * std::max(1u, std::thread::hardware_concurrency()); t *= 2) {
+            o.threads.push_back(t);
+        }
+    }
+    return o;
+}
+
+int main(int argc, char *argv[]) {
+    const Options o = parse(argc, argv);
+    const Zipf zipf(keys, 0.99);
+    std::vector<Result> results;
+    sweep<8>(o, zipf, results);
+    sweep<64>(o, zipf, results);
+    sweep<512>(o, zipf, results);
+
+    std::printf("%-21s %-9s %7s %5s %-9s %5s %12s %9s %9s %9s\n", "container", "workload",
+                "threads", "read", "keys", "value", "ops/s", "p50 ns", "p99 ns", "p999 ns");
+    for (auto &r : results) {
+        std::printf("%-21s %-9s %7u %5.2f %-9s %5zu %12.3e %9llu %9llu %9llu\n",
+                    r.config.container.c_str(), r.config.workload.c_str(), r.config.threads,
+                    r.config.read_ratio, r.config.key_dist.c_str(), r.config.value_size,
+                    r.ops_per_sec, static_cast<unsigned long long>(r.p50_ns),
+                    static_cast<unsigned long long>(r.p99_ns),
+                    static_cast<unsigned long long>(r.p999_ns));
+    }
+    std::FILE *f = std::fopen(o.out.c_str(), "w");
+    if (!f) {
+        std::perror(o.out.c_str());
+        return 1;
+    }
+    write_json(f, results);
+    std::fclose(f);
+    return 0;
+}